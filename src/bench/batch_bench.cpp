@@ -0,0 +1,117 @@
+/**
+ * Per-page cost of batched versus single page reads.
+ *
+ * Reads random batches of distinct pages of a 4096-page file, once with one
+ * readPage/unPinPage call per page and once with one readPages/unPinPages
+ * call per batch, and prints the average time per page for batches of 8 to
+ * 256 pages.  In the hit workload the whole file is resident; in the miss
+ * workload the pool has 512 frames, so most pages are read from the file
+ * (and from the operating system's page cache).
+ *
+ * Usage: ./bench/batch_bench [pages_per_run]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "buffer.h"
+#include "file.h"
+#include "exceptions/file_not_found_exception.h"
+
+using namespace badgerdb;
+
+typedef std::chrono::steady_clock Clock;
+
+namespace {
+
+const PageId FILE_PAGES = 4096;
+
+/**
+ * Nanoseconds per page of reading and unpinning the given batches.
+ */
+double run(BufMgr &bufMgr, File &file, const std::vector<std::vector<PageId>> &batches, const bool batched)
+{
+	std::vector<Page*> pages;
+	Page *page;
+	std::uint64_t total = 0;
+	const Clock::time_point start = Clock::now();
+	for (const std::vector<PageId> &batch : batches)
+	{
+		if (batched)
+		{
+			bufMgr.readPages(&file, batch, pages);
+			bufMgr.unPinPages(&file, batch, false);
+		}
+		else
+		{
+			for (const PageId pageNo : batch)
+				bufMgr.readPage(&file, pageNo, page);
+			for (const PageId pageNo : batch)
+				bufMgr.unPinPage(&file, pageNo, false);
+		}
+		total += batch.size();
+	}
+	return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / total;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+	std::size_t pagesPerRun = 200000;
+	if (argc > 1)
+		pagesPerRun = std::strtoul(argv[1], NULL, 10);
+
+	const std::string filename = "bench.batch";
+	try
+	{
+		File::remove(filename);
+	}
+	catch (FileNotFoundException &)
+	{
+	}
+
+	{
+		File file = File::create(filename);
+		for (PageId i = 0; i < FILE_PAGES; i++)
+			file.allocatePage();
+
+		std::vector<PageId> all(FILE_PAGES);
+		for (PageId i = 0; i < FILE_PAGES; i++)
+			all[i] = i + 1;
+
+		std::cout << "batch   hit ns/page single  batched    miss ns/page single  batched\n";
+		for (const std::size_t size : {8, 32, 128, 256})
+		{
+			std::mt19937 rng(size);
+			std::vector<std::vector<PageId>> batches;
+			for (std::size_t done = 0; done < pagesPerRun; done += size)
+			{
+				std::shuffle(all.begin(), all.end(), rng);
+				batches.push_back(std::vector<PageId>(all.begin(), all.begin() + size));
+			}
+
+			std::cout << std::setw(5) << size << std::fixed << std::setprecision(0);
+			BufMgr hitMgr(2 * FILE_PAGES);
+			run(hitMgr, file, batches, false);	// preload
+			std::cout << "             " << std::setw(6) << run(hitMgr, file, batches, false)
+								<< "  " << std::setw(7) << run(hitMgr, file, batches, true);
+			for (const bool batched : {false, true})
+			{
+				BufMgr missMgr(512);
+				std::cout << (batched ? "  " : "                 ") << std::setw(7) << run(missMgr, file, batches, batched);
+			}
+			std::cout << "\n";
+		}
+	}
+
+	File::remove(filename);
+	return 0;
+}
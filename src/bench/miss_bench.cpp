@@ -0,0 +1,110 @@
+/**
+ * Micro-benchmark for the buffer pool miss path.
+ *
+ * Compares the cost of a hash table miss reported through
+ * HashNotFoundException (the old BufMgr hot path) against the non-throwing
+ * BufHashTbl::tryLookup(), and measures the latency of BufMgr::readPage and
+ * BufMgr::unPinPage when the requested page is not resident.
+ *
+ * Build with "make bench" and run ./src/bench/miss_bench from the src
+ * directory.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+#include "buffer.h"
+#include "bufHashTbl.h"
+#include "file.h"
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/hash_not_found_exception.h"
+
+using namespace badgerdb;
+
+typedef std::chrono::steady_clock Clock;
+
+static double nsPerOp(Clock::time_point start, Clock::time_point end, std::uint64_t ops)
+{
+	return std::chrono::duration<double, std::nano>(end - start).count() / ops;
+}
+
+int main()
+{
+	const std::string filename = "bench.miss";
+	const std::uint32_t bufs = 64;
+	const PageId filePages = 4 * bufs;
+	const std::uint64_t probes = 1000000;
+	const std::uint64_t reads = 200000;
+
+	try
+	{
+		File::remove(filename);
+	}
+	catch (FileNotFoundException &)
+	{
+	}
+
+	{
+		File file = File::create(filename);
+		for (PageId i = 0; i < filePages; i++)
+			file.allocatePage();
+
+		// Hash table probes for pages which are never resident.
+		BufHashTbl table(bufs);
+		for (FrameId f = 0; f < bufs; f++)
+			table.insert(&file, f + 1, f);
+
+		std::uint64_t misses = 0;
+		Clock::time_point start = Clock::now();
+		for (std::uint64_t i = 0; i < probes; i++)
+		{
+			FrameId frameNo;
+			try
+			{
+				table.lookup(&file, bufs + 1 + (i % filePages), frameNo);
+			}
+			catch (const HashNotFoundException &)
+			{
+				misses++;
+			}
+		}
+		Clock::time_point end = Clock::now();
+		std::cout << "lookup() miss (throwing):        " << nsPerOp(start, end, probes) << " ns/op\n";
+
+		misses = 0;
+		start = Clock::now();
+		for (std::uint64_t i = 0; i < probes; i++)
+		{
+			FrameId frameNo;
+			if (!table.tryLookup(makePageKey(file.id(), bufs + 1 + (i % filePages)), frameNo))
+				misses++;
+		}
+		end = Clock::now();
+		std::cout << "tryLookup() miss (non-throwing): " << nsPerOp(start, end, probes) << " ns/op\n";
+
+		// Unpinning pages which are not resident is a pure hash miss.
+		BufMgr bufMgr(bufs);
+		start = Clock::now();
+		for (std::uint64_t i = 0; i < probes; i++)
+			bufMgr.unPinPage(&file, 1 + (i % filePages), false);
+		end = Clock::now();
+		std::cout << "unPinPage() of non-resident page: " << nsPerOp(start, end, probes) << " ns/op\n";
+
+		// Cycling over a file four times larger than the pool misses on every read.
+		Page *page;
+		start = Clock::now();
+		for (std::uint64_t i = 0; i < reads; i++)
+		{
+			const PageId pageNo = 1 + (i % filePages);
+			bufMgr.readPage(&file, pageNo, page);
+			bufMgr.unPinPage(&file, pageNo, false);
+		}
+		end = Clock::now();
+		std::cout << "readPage() miss + unPinPage():    " << nsPerOp(start, end, reads) << " ns/op\n";
+	}
+
+	File::remove(filename);
+	return 0;
+}
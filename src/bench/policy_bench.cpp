@@ -0,0 +1,178 @@
+/**
+ * Hit ratio of every page replacement policy on the same workloads.
+ *
+ * Replays seeded page reference strings against a buffer pool of 256 frames
+ * for each policy and prints the hit ratio of the point lookups (of all
+ * requests for the loop):
+ *
+ *   zipf       point lookups on a 2048-page table, Zipf distributed (s = 1)
+ *   zipf+scan  the same lookups, with every fourth request going to the next
+ *              page of a repeated scan of a separate 2048-page report file
+ *   zipf+ring  as zipf+scan, but the scan reads through an 8-frame BufRing
+ *   loop       repeated sequential scans of a 320-page file
+ *
+ * Usage: ./bench/policy_bench [requests_per_workload]
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "buffer.h"
+#include "file.h"
+#include "exceptions/file_not_found_exception.h"
+
+using namespace badgerdb;
+
+namespace {
+
+const std::uint32_t BUFS = 256;
+const PageId TABLE_PAGES = 2048;
+const PageId REPORT_PAGES = 2048;
+const PageId LOOP_PAGES = 320;
+
+/**
+ * A page request: which file and which page.
+ */
+struct Request
+{
+	int file;
+	PageId pageNo;
+};
+
+void removeIfExists(const std::string &name)
+{
+	try
+	{
+		File::remove(name);
+	}
+	catch (FileNotFoundException &)
+	{
+	}
+}
+
+/**
+ * Draws page numbers 1..pages with Zipf distributed popularity.  The popular
+ * pages are scattered over the file rather than being the first ones.
+ */
+class ZipfPages
+{
+ public:
+	ZipfPages(const PageId pages, std::mt19937 &rng)
+		: cdf(pages), pageOfRank(pages)
+	{
+		double sum = 0;
+		for (PageId i = 0; i < pages; i++)
+		{
+			sum += 1.0 / (i + 1);
+			cdf[i] = sum;
+		}
+		for (PageId i = 0; i < pages; i++)
+		{
+			cdf[i] /= sum;
+			pageOfRank[i] = i + 1;
+		}
+		std::shuffle(pageOfRank.begin(), pageOfRank.end(), rng);
+	}
+
+	PageId next(std::mt19937 &rng)
+	{
+		const double u = std::uniform_real_distribution<double>(0, 1)(rng);
+		const std::size_t rank = std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin();
+		return pageOfRank[std::min(rank, cdf.size() - 1)];
+	}
+
+ private:
+	std::vector<double> cdf;
+	std::vector<PageId> pageOfRank;
+};
+
+}
+
+int main(int argc, char *argv[])
+{
+	std::size_t requests = 200000;
+	if (argc > 1)
+		requests = std::strtoul(argv[1], NULL, 10);
+
+	const std::string names[] = {"bench.policy.table", "bench.policy.report", "bench.policy.loop"};
+	const PageId sizes[] = {TABLE_PAGES, REPORT_PAGES, LOOP_PAGES};
+	for (const std::string &name : names)
+		removeIfExists(name);
+
+	{
+		std::vector<File> files;
+		for (int f = 0; f < 3; f++)
+		{
+			files.push_back(File::create(names[f]));
+			for (PageId i = 0; i < sizes[f]; i++)
+				files[f].allocatePage();
+		}
+
+		// the same reference strings are replayed against every policy
+		std::mt19937 rng(42);
+		ZipfPages zipf(TABLE_PAGES, rng);
+		std::vector<Request> workloads[4];
+		PageId scanPos = 0;
+		PageId loopPos = 0;
+		for (std::size_t i = 0; i < requests; i++)
+		{
+			workloads[0].push_back({0, zipf.next(rng)});
+			if (i % 4 == 3)
+			{
+				workloads[1].push_back({1, scanPos + 1});
+				scanPos = (scanPos + 1) % REPORT_PAGES;
+			}
+			else
+				workloads[1].push_back({0, zipf.next(rng)});
+			workloads[3].push_back({2, loopPos + 1});
+			loopPos = (loopPos + 1) % LOOP_PAGES;
+		}
+
+		const ReplacementPolicy policies[] = {ReplacementPolicy::CLOCK, ReplacementPolicy::LRU_K,
+			ReplacementPolicy::TWO_Q, ReplacementPolicy::ARC, ReplacementPolicy::CLOCK_PRO};
+		// the ring workload replays the scan workload
+		workloads[2] = workloads[1];
+
+		std::cout << "policy      zipf      zipf+scan  zipf+ring  loop\n";
+		for (const ReplacementPolicy policy : policies)
+		{
+			std::cout << std::left << std::setw(10) << Replacer::name(policy) << std::right << std::fixed
+								<< std::setprecision(4);
+			for (int w = 0; w < 4; w++)
+			{
+				BufMgr bufMgr(BUFS, BufMgr::DEFAULT_PARTITIONS, policy);
+				BufRing ring(bufMgr, 8);
+				Page *page;
+				std::uint64_t lookups = 0;
+				std::uint64_t misses = 0;
+				for (const Request &request : workloads[w])
+				{
+					const std::uint64_t before = bufMgr.getBufStats().diskreads;
+					if (request.file == 1 && w == 2)
+						bufMgr.readPage(&files[request.file], request.pageNo, page, ring);
+					else
+						bufMgr.readPage(&files[request.file], request.pageNo, page);
+					bufMgr.unPinPage(&files[request.file], request.pageNo, false);
+					if (request.file != 1)
+					{
+						lookups++;
+						misses += bufMgr.getBufStats().diskreads - before;
+					}
+				}
+				std::cout << "  " << std::setw(9) << 1.0 - (double)misses / lookups;
+			}
+			std::cout << "\n";
+		}
+	}
+
+	for (const std::string &name : names)
+		removeIfExists(name);
+	return 0;
+}
@@ -0,0 +1,127 @@
+/**
+ * Multi-threaded scaling benchmark for the buffer manager.
+ *
+ * Preloads a file which fits in the buffer pool and then lets 1..N threads
+ * read random pages of it for a fixed time, so nearly every read is a hit.
+ * Each step is run twice: once pinning the pages with readPage/unPinPage and
+ * once reading them with readPageOptimistic.  Reports the aggregate
+ * throughput of both for each thread count.
+ *
+ * Usage: ./bench/scaling_bench [max_threads] [seconds_per_step]
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "buffer.h"
+#include "file.h"
+#include "exceptions/file_not_found_exception.h"
+
+using namespace badgerdb;
+
+typedef std::chrono::steady_clock Clock;
+
+int main(int argc, char *argv[])
+{
+	const std::string filename = "bench.scaling";
+	const std::uint32_t bufs = 4096;
+	const PageId filePages = bufs / 2;
+	unsigned maxThreads = std::thread::hardware_concurrency();
+	double seconds = 1.0;
+
+	if (argc > 1)
+		maxThreads = std::atoi(argv[1]);
+	if (argc > 2)
+		seconds = std::atof(argv[2]);
+	if (maxThreads == 0)
+		maxThreads = 1;
+
+	try
+	{
+		File::remove(filename);
+	}
+	catch (FileNotFoundException &)
+	{
+	}
+
+	{
+		File file = File::create(filename);
+		for (PageId i = 0; i < filePages; i++)
+			file.allocatePage();
+
+		BufMgr bufMgr(bufs);
+		Page *page;
+		for (PageId i = 1; i <= filePages; i++)
+		{
+			bufMgr.readPage(&file, i, page);
+			bufMgr.unPinPage(&file, i, false);
+		}
+
+		// aggregate reads per second of n threads, pinning or optimistic
+		auto run = [&](const unsigned n, const bool optimistic) {
+			std::atomic<bool> stop(false);
+			std::atomic<std::uint64_t> total(0);
+			std::vector<std::thread> threads;
+			for (unsigned t = 0; t < n; t++)
+			{
+				threads.push_back(std::thread([&, t]() {
+					std::mt19937 rng(t + 1);
+					std::uint64_t ops = 0;
+					std::uint64_t sum = 0;
+					Page *threadPage;
+					while (!stop.load(std::memory_order_relaxed))
+					{
+						const PageId pageNo = 1 + rng() % filePages;
+						if (optimistic)
+						{
+							PageId seen = 0;
+							bufMgr.readPageOptimistic(&file, pageNo, [&](const Page &p) { seen = p.page_number(); });
+							sum += seen;
+						}
+						else
+						{
+							bufMgr.readPage(&file, pageNo, threadPage);
+							sum += threadPage->page_number();
+							bufMgr.unPinPage(&file, pageNo, false);
+						}
+						ops++;
+					}
+					if (sum == 0)
+						std::cerr << "no pages read\n";
+					total += ops;
+				}));
+			}
+			std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+			stop = true;
+			for (std::thread &th : threads)
+				th.join();
+			return total / seconds;
+		};
+
+		std::cout << "threads  pinned ops/s  speedup  optimistic ops/s  speedup\n";
+		double pinnedBase = 0;
+		double optimisticBase = 0;
+		for (unsigned n = 1; n <= maxThreads; n++)
+		{
+			const double pinned = run(n, false);
+			const double optimistic = run(n, true);
+			if (n == 1)
+			{
+				pinnedBase = pinned;
+				optimisticBase = optimistic;
+			}
+			std::cout << n << "        " << (std::uint64_t)pinned << "      " << pinned / pinnedBase
+								<< "        " << (std::uint64_t)optimistic << "          " << optimistic / optimisticBase << "\n";
+		}
+	}
+
+	File::remove(filename);
+	return 0;
+}
@@ -0,0 +1,434 @@
+/**
+ * Workload-driven benchmark of the buffer manager.
+ *
+ * Drives a BufMgr of each given pool size with each workload from one or
+ * more threads, over each given number of pages of a file.  Every
+ * operation reads one page and unpins it, dirty for the given fraction of
+ * operations.  The pool is warmed up with the same workload first.  For
+ * every run prints the throughput, the hit ratio of the reads, the pages
+ * written back and the 50th, 95th and 99th percentile latencies of an
+ * operation in microseconds.
+ *
+ *   uniform  pages drawn uniformly
+ *   zipf     pages drawn Zipf distributed (theta), the popular ones scattered
+ *   hotset   hotops of the operations go to a hot set of hotpages of the pages
+ *   scan     each thread reads through the file sequentially from a random page
+ *   mix      scanshare of the operations continue a scan, the rest are zipf
+ *
+ * Allocating a page walks the file's list of pages, so building the file
+ * takes minutes from some ten thousand pages on.  The file is built once for
+ * the largest size, and is reused rather than rebuilt if it already has
+ * enough pages; keep=1 leaves it in place for the next run.
+ *
+ * Usage: ./bench/workload_bench [name=value...]
+ *
+ *   workloads=uniform,zipf,hotset,scan,mix   pages=4096[,...]   frames=1024,4096
+ *   ops=200000   threads=1   writes=0.0   theta=0.99   hotpages=0.2   hotops=0.8
+ *   scanshare=0.2   policy=CLOCK   seed=42   file=bench.workload   keep=0
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "buffer.h"
+#include "file.h"
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/invalid_page_exception.h"
+
+using namespace badgerdb;
+
+typedef std::chrono::steady_clock Clock;
+
+namespace {
+
+const ReplacementPolicy POLICIES[] = {
+	ReplacementPolicy::CLOCK, ReplacementPolicy::LRU_K, ReplacementPolicy::TWO_Q,
+	ReplacementPolicy::ARC, ReplacementPolicy::CLOCK_PRO
+};
+
+/**
+ * Settings of a run, from the command line.
+ */
+struct Settings
+{
+	std::vector<std::string> workloads = {"uniform", "zipf", "hotset", "scan", "mix"};
+	std::vector<std::uint32_t> pages = {4096};
+	std::vector<std::uint32_t> frames = {1024, 4096};
+	std::uint64_t ops = 200000;
+	unsigned threads = 1;
+	double writes = 0.0;
+	double theta = 0.99;
+	double hotPages = 0.2;
+	double hotOps = 0.8;
+	double scanShare = 0.2;
+	ReplacementPolicy policy = ReplacementPolicy::CLOCK;
+	std::uint32_t seed = 42;
+	std::string file = "bench.workload";
+	bool keep = false;
+};
+
+std::vector<std::string> split(const std::string &list)
+{
+	std::vector<std::string> items;
+	std::stringstream stream(list);
+	std::string item;
+	while (std::getline(stream, item, ','))
+		items.push_back(item);
+	return items;
+}
+
+std::vector<std::uint32_t> splitNumbers(const std::string &list)
+{
+	std::vector<std::uint32_t> numbers;
+	for (const std::string &item : split(list))
+		numbers.push_back(std::strtoul(item.c_str(), NULL, 10));
+	return numbers;
+}
+
+/**
+ * Draws page numbers 1..pages with Zipf distributed popularity of skew theta.
+ * The popular pages are scattered over the file rather than being the first
+ * ones.  Shared read-only by the threads.
+ */
+class ZipfPages
+{
+ public:
+	ZipfPages(const PageId pages, const double theta, std::mt19937 &rng)
+		: cdf(pages), pageOfRank(pages)
+	{
+		double sum = 0;
+		for (PageId i = 0; i < pages; i++)
+		{
+			sum += 1.0 / std::pow(i + 1, theta);
+			cdf[i] = sum;
+		}
+		for (PageId i = 0; i < pages; i++)
+		{
+			cdf[i] /= sum;
+			pageOfRank[i] = i + 1;
+		}
+		std::shuffle(pageOfRank.begin(), pageOfRank.end(), rng);
+	}
+
+	PageId next(std::mt19937 &rng) const
+	{
+		const double u = std::uniform_real_distribution<double>(0, 1)(rng);
+		const std::size_t rank = std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin();
+		return pageOfRank[std::min(rank, cdf.size() - 1)];
+	}
+
+ private:
+	std::vector<double> cdf;
+	std::vector<PageId> pageOfRank;
+};
+
+/**
+ * Page reference string of one thread for one of the workloads.
+ */
+class Workload
+{
+ public:
+	Workload(const std::string &name, const Settings &settings, const PageId pages,
+	         const ZipfPages &zipf, const std::uint32_t seed)
+		: name(name), settings(settings), pages(pages), zipf(zipf), rng(seed),
+		  hotPages(std::max<PageId>(1, (PageId)(pages * settings.hotPages))),
+		  scanPos(std::uniform_int_distribution<PageId>(0, pages - 1)(rng))
+	{
+	}
+
+	PageId next()
+	{
+		if (name == "uniform")
+			return uniform(1, pages);
+		if (name == "zipf")
+			return zipf.next(rng);
+		if (name == "hotset")
+		{
+			// the hot set is the first pages of the file
+			if (real() < settings.hotOps || hotPages == pages)
+				return uniform(1, hotPages);
+			return uniform(hotPages + 1, pages);
+		}
+		if (name == "mix" && real() >= settings.scanShare)
+			return zipf.next(rng);
+		scanPos = (scanPos + 1) % pages;
+		return scanPos + 1;
+	}
+
+	bool write()
+	{
+		return settings.writes > 0 && real() < settings.writes;
+	}
+
+ private:
+	const std::string name;
+	const Settings &settings;
+	const PageId pages;
+	const ZipfPages &zipf;
+	std::mt19937 rng;
+	const PageId hotPages;
+	PageId scanPos;
+
+	PageId uniform(const PageId first, const PageId last)
+	{
+		return std::uniform_int_distribution<PageId>(first, last)(rng);
+	}
+
+	double real()
+	{
+		return std::uniform_real_distribution<double>(0, 1)(rng);
+	}
+};
+
+/**
+ * Results of one run.
+ */
+struct Result
+{
+	double seconds;
+	double hitRatio;
+	std::uint64_t diskwrites;
+	std::vector<std::uint32_t> latencies;
+};
+
+/**
+ * Runs ops operations of the workload on bufMgr, split over the threads, and
+ * collects the latency of every operation in nanoseconds if timed.
+ */
+double runThreads(BufMgr &bufMgr, File &file, const std::string &name, const Settings &settings,
+                  const PageId pages, const ZipfPages &zipf, const std::uint64_t ops,
+                  const std::uint32_t seed, std::vector<std::uint32_t> *latencies)
+{
+	std::vector<std::vector<std::uint32_t> > threadLatencies(settings.threads);
+	std::vector<std::thread> threads;
+	const Clock::time_point start = Clock::now();
+	for (unsigned t = 0; t < settings.threads; t++)
+	{
+		threads.push_back(std::thread([&, t]() {
+			Workload workload(name, settings, pages, zipf, seed + t);
+			const std::uint64_t count = ops / settings.threads + (t < ops % settings.threads);
+			std::vector<std::uint32_t> &times = threadLatencies[t];
+			if (latencies)
+				times.reserve(count);
+			Page *page;
+			for (std::uint64_t i = 0; i < count; i++)
+			{
+				const PageId pageNo = workload.next();
+				const bool dirty = workload.write();
+				const Clock::time_point begin = latencies ? Clock::now() : Clock::time_point();
+				bufMgr.readPage(&file, pageNo, page);
+				bufMgr.unPinPage(&file, pageNo, dirty);
+				if (latencies)
+					times.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - begin).count());
+			}
+		}));
+	}
+	for (std::thread &thread : threads)
+		thread.join();
+	const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	if (latencies)
+	{
+		for (const std::vector<std::uint32_t> &times : threadLatencies)
+			latencies->insert(latencies->end(), times.begin(), times.end());
+	}
+	return seconds;
+}
+
+Result run(File &file, const std::string &name, const Settings &settings, const PageId pages,
+           const std::uint32_t frames, const ZipfPages &zipf)
+{
+	BufMgr bufMgr(frames, BufMgr::DEFAULT_PARTITIONS, settings.policy);
+	// warms the pool up with as many operations as it has frames, at least
+	runThreads(bufMgr, file, name, settings, pages, zipf, std::max<std::uint64_t>(frames, settings.ops / 5),
+	           settings.seed + 1000, NULL);
+	bufMgr.clearBufStats();
+
+	Result result;
+	result.seconds = runThreads(bufMgr, file, name, settings, pages, zipf, settings.ops, settings.seed,
+	                            &result.latencies);
+	const BufStats &stats = bufMgr.getBufStats();
+	result.hitRatio = stats.hitRatio();
+	result.diskwrites = stats.diskwrites;
+	return result;
+}
+
+/**
+ * Returns the given percentile of the latencies in microseconds, reordering them.
+ */
+double percentile(std::vector<std::uint32_t> &latencies, const double fraction)
+{
+	if (latencies.empty())
+		return 0;
+	const std::size_t index = std::min(latencies.size() - 1, (std::size_t)(fraction * latencies.size()));
+	std::nth_element(latencies.begin(), latencies.begin() + index, latencies.end());
+	return latencies[index] / 1000.0;
+}
+
+void removeIfExists(const std::string &name)
+{
+	try
+	{
+		File::remove(name);
+	}
+	catch (FileNotFoundException &)
+	{
+	}
+}
+
+/**
+ * Opens the file if it has at least pages pages, or else builds it anew.
+ */
+File openOrBuild(const std::string &name, const PageId pages)
+{
+	if (File::exists(name))
+	{
+		File file = File::open(name);
+		try
+		{
+			file.readPage(pages);
+			return file;
+		}
+		catch (InvalidPageException &)
+		{
+		}
+	}
+	removeIfExists(name);
+	File file = File::create(name);
+	for (PageId i = 0; i < pages; i++)
+		file.allocatePage();
+	return file;
+}
+
+bool parse(Settings &settings, const std::string &arg)
+{
+	const std::size_t eq = arg.find('=');
+	if (eq == std::string::npos)
+		return false;
+	const std::string key = arg.substr(0, eq);
+	const std::string value = arg.substr(eq + 1);
+	if (key == "workloads")
+	{
+		settings.workloads = split(value);
+		for (const std::string &name : settings.workloads)
+		{
+			if (name != "uniform" && name != "zipf" && name != "hotset" && name != "scan" && name != "mix")
+				return false;
+		}
+	}
+	else if (key == "pages")
+		settings.pages = splitNumbers(value);
+	else if (key == "frames")
+		settings.frames = splitNumbers(value);
+	else if (key == "ops")
+		settings.ops = std::strtoull(value.c_str(), NULL, 10);
+	else if (key == "threads")
+		settings.threads = std::max(1, std::atoi(value.c_str()));
+	else if (key == "writes")
+		settings.writes = std::atof(value.c_str());
+	else if (key == "theta")
+		settings.theta = std::atof(value.c_str());
+	else if (key == "hotpages")
+		settings.hotPages = std::atof(value.c_str());
+	else if (key == "hotops")
+		settings.hotOps = std::atof(value.c_str());
+	else if (key == "scanshare")
+		settings.scanShare = std::atof(value.c_str());
+	else if (key == "seed")
+		settings.seed = std::strtoul(value.c_str(), NULL, 10);
+	else if (key == "file")
+		settings.file = value;
+	else if (key == "keep")
+		settings.keep = std::atoi(value.c_str()) != 0;
+	else if (key == "policy")
+	{
+		for (const ReplacementPolicy policy : POLICIES)
+		{
+			if (value == Replacer::name(policy))
+			{
+				settings.policy = policy;
+				return true;
+			}
+		}
+		return false;
+	}
+	else
+		return false;
+	return true;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+	Settings settings;
+	for (int i = 1; i < argc; i++)
+	{
+		if (!parse(settings, argv[i]))
+		{
+			std::cerr << "bad argument " << argv[i] << "\n"
+			          << "usage: " << argv[0] << " [workloads=uniform,zipf,hotset,scan,mix] [pages=N,...]"
+			          << " [frames=N,...] [ops=N] [threads=N] [writes=F] [theta=F] [hotpages=F]"
+			          << " [hotops=F] [scanshare=F] [policy=NAME] [seed=N] [file=NAME] [keep=0|1]\n";
+			return 2;
+		}
+	}
+	for (const std::uint32_t pages : settings.pages)
+	{
+		if (pages == 0)
+		{
+			std::cerr << "bad file size 0\n";
+			return 2;
+		}
+	}
+	for (const std::uint32_t frames : settings.frames)
+	{
+		if (frames < settings.threads)
+		{
+			std::cerr << "pool of " << frames << " frames is smaller than the number of threads\n";
+			return 2;
+		}
+	}
+
+	std::cout << "policy " << Replacer::name(settings.policy) << ", " << settings.threads << " threads, "
+	          << settings.ops << " ops, " << settings.writes << " writes\n";
+	std::cout << std::left << std::setw(9) << "workload" << std::right << std::setw(9) << "pages"
+	          << std::setw(8) << "frames" << std::setw(12) << "ops/s" << std::setw(10) << "hit ratio"
+	          << std::setw(10) << "written" << std::setw(10) << "p50 us" << std::setw(10) << "p95 us"
+	          << std::setw(10) << "p99 us" << "\n";
+	{
+		// smaller sizes use the first pages of the file
+		File file = openOrBuild(settings.file, *std::max_element(settings.pages.begin(), settings.pages.end()));
+		for (const std::uint32_t pages : settings.pages)
+		{
+			std::mt19937 rng(settings.seed);
+			const ZipfPages zipf(pages, settings.theta, rng);
+			for (const std::uint32_t frames : settings.frames)
+			{
+				for (const std::string &name : settings.workloads)
+				{
+					Result result = run(file, name, settings, pages, frames, zipf);
+					std::cout << std::left << std::setw(9) << name << std::right << std::setw(9) << pages
+					          << std::setw(8) << frames << std::fixed << std::setprecision(0) << std::setw(12)
+					          << settings.ops / result.seconds << std::setprecision(4) << std::setw(10)
+					          << result.hitRatio << std::setw(10) << result.diskwrites << std::setprecision(2)
+					          << std::setw(10) << percentile(result.latencies, 0.50)
+					          << std::setw(10) << percentile(result.latencies, 0.95)
+					          << std::setw(10) << percentile(result.latencies, 0.99) << "\n";
+				}
+			}
+		}
+	}
+	if (!settings.keep)
+		removeIfExists(settings.file);
+	return 0;
+}
@@ -0,0 +1,132 @@
+/**
+ * Write-back throughput of the buffer manager.
+ *
+ * Keeps a 4096-page file resident in a pool of the same size, dirties every
+ * page and times flushFile() writing them all back, then does the same for
+ * dirty pages written back by evictions, reading a second file through a
+ * pool that only holds a quarter of it, and for the destructor writing back a
+ * pool full of pages of two files dirtied in random order.  Prints pages
+ * written per second.
+ *
+ * Usage: ./bench/writeback_bench [rounds]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "buffer.h"
+#include "file.h"
+#include "exceptions/file_not_found_exception.h"
+
+using namespace badgerdb;
+
+typedef std::chrono::steady_clock Clock;
+
+namespace {
+
+const PageId FILE_PAGES = 4096;
+
+void removeIfExists(const std::string &name)
+{
+	try
+	{
+		File::remove(name);
+	}
+	catch (FileNotFoundException &)
+	{
+	}
+}
+
+/**
+ * Pins and unpins the pages first..last of the file, marking them dirty.
+ */
+void dirty(BufMgr &bufMgr, File &file, const PageId first, const PageId last)
+{
+	Page *page;
+	for (PageId i = first; i <= last; i++)
+	{
+		bufMgr.readPage(&file, i, page);
+		bufMgr.unPinPage(&file, i, true);
+	}
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+	int rounds = 5;
+	if (argc > 1)
+		rounds = std::atoi(argv[1]);
+
+	const std::string name = "bench.writeback";
+	const std::string otherName = "bench.writeback2";
+	removeIfExists(name);
+	removeIfExists(otherName);
+	{
+		File file = File::create(name);
+		File other = File::create(otherName);
+		for (PageId i = 0; i < FILE_PAGES; i++)
+		{
+			file.allocatePage();
+			other.allocatePage();
+		}
+
+		// pages of both files, in the order the shutdown case dirties them
+		std::vector<std::pair<File *, PageId> > shuffled;
+		for (PageId i = 1; i <= FILE_PAGES; i++)
+		{
+			shuffled.push_back(std::make_pair(&file, i));
+			shuffled.push_back(std::make_pair(&other, i));
+		}
+		std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(42));
+
+		double flushSeconds = 0;
+		double evictSeconds = 0;
+		double shutdownSeconds = 0;
+		for (int r = 0; r < rounds; r++)
+		{
+			{
+				BufMgr bufMgr(FILE_PAGES);
+				dirty(bufMgr, file, 1, FILE_PAGES);
+				const Clock::time_point start = Clock::now();
+				bufMgr.flushFile(&file);
+				flushSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+			}
+			{
+				// every miss after the first quarter evicts a dirty page
+				BufMgr bufMgr(FILE_PAGES / 4);
+				dirty(bufMgr, file, 1, FILE_PAGES / 4);
+				const Clock::time_point start = Clock::now();
+				dirty(bufMgr, file, FILE_PAGES / 4 + 1, FILE_PAGES);
+				evictSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+				bufMgr.flushFile(&file);
+			}
+			Clock::time_point start;
+			{
+				BufMgr bufMgr(2 * FILE_PAGES);
+				Page *page;
+				for (const std::pair<File *, PageId> &p : shuffled)
+				{
+					bufMgr.readPage(p.first, p.second, page);
+					bufMgr.unPinPage(p.first, p.second, true);
+				}
+				start = Clock::now();
+			}
+			shutdownSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+		}
+
+		std::cout << "flushFile():      " << (std::uint64_t)(rounds * FILE_PAGES / flushSeconds) << " pages/s\n";
+		std::cout << "dirty evictions:  " << (std::uint64_t)(rounds * (FILE_PAGES - FILE_PAGES / 4) / evictSeconds)
+							<< " pages/s (including the reads)\n";
+		std::cout << "~BufMgr():        " << (std::uint64_t)(rounds * 2 * FILE_PAGES / shutdownSeconds) << " pages/s\n";
+	}
+	removeIfExists(name);
+	removeIfExists(otherName);
+	return 0;
+}
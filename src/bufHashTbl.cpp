@@ -7,7 +7,9 @@
  * 
  */
 
+#include <cstdint>
 #include <memory>
+#include <new>
 #include <iostream>
 #include "buffer.h"
 #include "bufHashTbl.h"
@@ -18,40 +20,94 @@
 namespace badgerdb {
 
 /**
-* returns hash value between 0 and HTSIZE-1 computed using file and pageNo
+* returns hash value between 0 and HTSIZE-1 computed using the page key
 *
-* @param file   	File object
-* @param pageNo  Page number in the file
+* @param key  	  Page key
 * @return  			Hash value.
 */
-int BufHashTbl::hash(const File* file, const PageId pageNo)
+int BufHashTbl::hash(const PageKey key) const
 {
-  int tmp, value;
-  tmp = (long)file;  // cast of pointer to the file object to an integer
-  value = (tmp + pageNo) % HTSIZE;
-  return value;
+  return (int)mix(key) & (HTSIZE - 1);
+}
+
+/**
+* returns the index of the bucket holding key, or -1 if absent
+*
+* @param key  	  Page key
+* @return  			Bucket index.
+*/
+int BufHashTbl::find(const PageKey key) const
+{
+  int index = hash(key);
+  while (keys[index] != EMPTY_KEY) {
+    if (keys[index] == key)
+      return index;
+    index = (index + 1) & (HTSIZE - 1);
+  }
+  return -1;
 }
 
 BufHashTbl::BufHashTbl(int htSize)
-	: HTSIZE(htSize)
+	: HTSIZE(1), capacity(htSize > 0 ? htSize : 1), numEntries(0), numRetired(0)
 {
-  // allocate an array of pointers to hashBuckets
-  ht = new hashBucket* [htSize];
+  // keep the load factor at or below one half so probe sequences stay short
+  while (HTSIZE < 2 * capacity)
+    HTSIZE <<= 1;
+  keys = new PageKey[HTSIZE];
+  frames = new FrameId[HTSIZE];
   for(int i=0; i < HTSIZE; i++)
-    ht[i] = NULL;
+    keys[i] = EMPTY_KEY;
+}
+
+/**
+* doubles the capacity of the table and rehashes all entries
+*
+* @throws  HashTableException if the larger table could not be allocated
+*/
+void BufHashTbl::grow()
+{
+  const int newSize = 2 * HTSIZE;
+  PageKey* newKeys = NULL;
+  FrameId* newFrames = NULL;
+  try {
+    newKeys = new PageKey[newSize];
+    newFrames = new FrameId[newSize];
+  } catch (const std::bad_alloc &) {
+    delete [] newKeys;
+    throw HashTableException();
+  }
+
+  for(int i=0; i < newSize; i++)
+    newKeys[i] = EMPTY_KEY;
+  for(int i=0; i < HTSIZE; i++) {
+    if (keys[i] == EMPTY_KEY)
+      continue;
+    int index = (int)mix(keys[i]) & (newSize - 1);
+    while (newKeys[index] != EMPTY_KEY)
+      index = (index + 1) & (newSize - 1);
+    newKeys[index] = keys[i];
+    newFrames[index] = frames[i];
+  }
+
+  // publish the new arrays before the new size, so an optimistic lookup
+  // which sees the larger size also sees the larger arrays
+  retiredKeys[numRetired] = keys;
+  retiredFrames[numRetired] = frames;
+  numRetired++;
+  __atomic_store_n(&frames, newFrames, __ATOMIC_RELEASE);
+  __atomic_store_n(&keys, newKeys, __ATOMIC_RELEASE);
+  __atomic_store_n(&HTSIZE, newSize, __ATOMIC_RELEASE);
+  capacity *= 2;
 }
 
 BufHashTbl::~BufHashTbl()
 {
-  for(int i = 0; i < HTSIZE; i++) {
-    hashBucket* tmpBuf = ht[i];
-    while (ht[i]) {
-      tmpBuf = ht[i];
-      ht[i] = ht[i]->next;
-      delete tmpBuf;
-    }
+  delete [] keys;
+  delete [] frames;
+  for(int i = 0; i < numRetired; i++) {
+    delete [] retiredKeys[i];
+    delete [] retiredFrames[i];
   }
-  delete [] ht;
 }
 
 /**
@@ -61,28 +117,16 @@ BufHashTbl::~BufHashTbl()
 * @param pageNo 	Page number in the file
 * @param frameNo Frame number assigned to that page of the file
 * @throws  HashAlreadyPresentException	if the corresponding page already exists in the hash table
-* @throws  HashTableException (optional) if could not create a new bucket as running of memory
+* @throws  HashTableException if the table is full and could not grow
 */
 void BufHashTbl::insert(const File* file, const PageId pageNo, const FrameId frameNo)
 {
-  int index = hash(file, pageNo);
-
-  hashBucket* tmpBuc = ht[index];
-  while (tmpBuc) {
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
-  		throw HashAlreadyPresentException(tmpBuc->file->filename(), tmpBuc->pageNo, tmpBuc->frameNo);
-    tmpBuc = tmpBuc->next;
+  const PageKey key = makePageKey(file->id(), pageNo);
+  if (!tryInsert(key, frameNo)) {
+    FrameId existing = 0;
+    tryLookup(key, existing);
+    throw HashAlreadyPresentException(file->filename(), pageNo, existing);
   }
-
-  tmpBuc = new hashBucket;
-  if (!tmpBuc)
-  	throw HashTableException();
-
-  tmpBuc->file = (File*) file;
-  tmpBuc->pageNo = pageNo;
-  tmpBuc->frameNo = frameNo;
-  tmpBuc->next = ht[index];
-  ht[index] = tmpBuc;
 }
 
 /**
@@ -96,18 +140,8 @@ void BufHashTbl::insert(const File* file, const PageId pageNo, const FrameId fra
 */
 void BufHashTbl::lookup(const File* file, const PageId pageNo, FrameId &frameNo) 
 {
-  int index = hash(file, pageNo);
-  hashBucket* tmpBuc = ht[index];
-  while (tmpBuc) {
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
-    {
-      frameNo = tmpBuc->frameNo; // return frameNo by reference
-      return;
-    }
-    tmpBuc = tmpBuc->next;
-  }
-
-  throw HashNotFoundException(file->filename(), pageNo);
+  if (!tryLookup(makePageKey(file->id(), pageNo), frameNo))
+    throw HashNotFoundException(file->filename(), pageNo);
 }
 
 /**
@@ -117,31 +151,121 @@ void BufHashTbl::lookup(const File* file, const PageId pageNo, FrameId &frameNo)
 * @param pageNo  Page number in the file
 * @throws HashNotFoundException if the page entry is not found in the hash table 
 */
-void BufHashTbl::remove(const File* file, const PageId pageNo) {
+void BufHashTbl::remove(const File* file, const PageId pageNo)
+{
+  if (!tryRemove(makePageKey(file->id(), pageNo)))
+    throw HashNotFoundException(file->filename(), pageNo);
+}
+
+/**
+* Insert entry into hash table mapping key to frameNo.
+*
+* @param key   	Page key of the page
+* @param frameNo Frame number assigned to that page
+* @return  false if the corresponding page already exists in the hash table
+* @throws  HashTableException if the table is full and could not grow
+*/
+bool BufHashTbl::tryInsert(const PageKey key, const FrameId frameNo)
+{
+  int index = hash(key);
+  while (keys[index] != EMPTY_KEY) {
+    if (keys[index] == key)
+      return false;
+    index = (index + 1) & (HTSIZE - 1);
+  }
 
-  int index = hash(file, pageNo);
-  hashBucket* tmpBuc = ht[index];
-  hashBucket* prevBuc = NULL;
+  if (numEntries >= capacity) {
+    grow();
+    index = hash(key);
+    while (keys[index] != EMPTY_KEY)
+      index = (index + 1) & (HTSIZE - 1);
+  }
 
-  while (tmpBuc)
-	{
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
-		{
-      if(prevBuc) 
-				prevBuc->next = tmpBuc->next;
-      else
-				ht[index] = tmpBuc->next;
+  // the frame goes in first, so a concurrent optimistic lookup which finds
+  // the key does not pick up a stale frame number
+  __atomic_store_n(&frames[index], frameNo, __ATOMIC_RELAXED);
+  __atomic_store_n(&keys[index], key, __ATOMIC_RELEASE);
+  numEntries++;
+  return true;
+}
+
+/**
+* Check if the page with the given key is currently in the buffer pool.
+*
+* @param key   	Page key of the page
+* @param frameNo Frame number reference
+* @return  true if the page entry is found in the hash table
+*/
+bool BufHashTbl::tryLookup(const PageKey key, FrameId &frameNo) const
+{
+  int index = find(key);
+  if (index < 0)
+    return false;
+  frameNo = frames[index]; // return frameNo by reference
+  return true;
+}
 
-      delete tmpBuc;
-      return;
+/**
+* Check if the page with the given key is in the hash table without holding
+* the partition latch.  The result may be wrong if the table is updated
+* concurrently.
+*
+* @param key   	Page key of the page
+* @param frameNo Frame number reference
+* @return  true if the page entry was found in the hash table
+*/
+bool BufHashTbl::tryLookupOptimistic(const PageKey key, FrameId &frameNo) const
+{
+  const int size = __atomic_load_n(&HTSIZE, __ATOMIC_ACQUIRE);
+  const PageKey* curKeys = __atomic_load_n(&keys, __ATOMIC_ACQUIRE);
+  const FrameId* curFrames = __atomic_load_n(&frames, __ATOMIC_ACQUIRE);
+
+  // bound the probe, a concurrent update may have removed the empty bucket
+  // which would have ended it
+  int index = (int)mix(key) & (size - 1);
+  for (int probes = 0; probes < size; probes++) {
+    const PageKey cur = __atomic_load_n(&curKeys[index], __ATOMIC_ACQUIRE);
+    if (cur == EMPTY_KEY)
+      return false;
+    if (cur == key) {
+      frameNo = __atomic_load_n(&curFrames[index], __ATOMIC_RELAXED);
+      return true;
     }
-		else
+    index = (index + 1) & (size - 1);
+  }
+  return false;
+}
+
+/**
+* Delete the entry for key from hash table.
+*
+* @param key   	Page key of the page
+* @return  false if the page entry is not found in the hash table
+*/
+bool BufHashTbl::tryRemove(const PageKey key) {
+
+  int index = find(key);
+  if (index < 0)
+    return false;
+
+  // Backward-shift deletion: move later members of the probe sequence into
+  // the hole unless their home bucket lies cyclically in (hole, next].
+  int hole = index;
+  int next = (hole + 1) & (HTSIZE - 1);
+  while (keys[next] != EMPTY_KEY)
+	{
+    int home = hash(keys[next]);
+    if (((next - home) & (HTSIZE - 1)) >= ((next - hole) & (HTSIZE - 1)))
 		{
-      prevBuc = tmpBuc;
-      tmpBuc = tmpBuc->next;
+      __atomic_store_n(&frames[hole], frames[next], __ATOMIC_RELAXED);
+      __atomic_store_n(&keys[hole], keys[next], __ATOMIC_RELEASE);
+      hole = next;
     }
+    next = (next + 1) & (HTSIZE - 1);
   }
-  throw HashNotFoundException(file->filename(), pageNo);
+  __atomic_store_n(&keys[hole], EMPTY_KEY, __ATOMIC_RELEASE);
+  numEntries--;
+  return true;
 }
 
 }
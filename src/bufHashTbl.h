@@ -12,60 +12,114 @@
 namespace badgerdb {
 
 /**
-* @brief Declarations for buffer pool hash table
+* @brief Hash table class to keep track of pages in the buffer pool
+*
+* Pages are identified by their PageKey, so all File objects open on the same
+* underlying file map to the same entries.  The table uses linear probing over
+* a power-of-two sized array which is allocated once in the constructor.  Keys
+* and frame numbers are kept in two parallel arrays, so a probe only walks the
+* 8 byte keys (eight per cache line) and touches the frame array once on a
+* hit.  Inserts and removes never allocate; removes shift the following
+* entries of the probe sequence back instead of leaving tombstones.  If more
+* than htSize entries are inserted the table doubles, so a partition of a
+* larger hash table can be sized for its expected share of the pages.
+*
+* @warning This class is not threadsafe; BufMgr latches each partition.  The
+* only exception is tryLookupOptimistic(), which may run concurrently with
+* updates and may therefore return a wrong frame or miss an entry.
+
 */
-struct hashBucket {
+class BufHashTbl
+{
+ private:
 	/**
-	 * pointer a file object (more on this below)
+	 * Key marking an empty bucket.  No page key uses File::INVALID_ID.
 	 */
-	File *file;
+  static const PageKey EMPTY_KEY = 0;
 
 	/**
-	 * page number within a file
+	 *	Size of Hash Table (number of buckets, always a power of two)
 	 */
-	PageId pageNo;
+  int HTSIZE;
 
 	/**
-	 * frame number of page in the buffer pool
+	 *	Number of entries the table holds before it has to grow
 	 */
-	FrameId frameNo;
+  int capacity;
 
 	/**
-	 * Next node in the hash table
+	 *	Number of entries currently in the table
 	 */
-	hashBucket*   next;
-};
+  int numEntries;
 
+	/**
+	 * Page key stored in each bucket, EMPTY_KEY if the bucket is empty
+	 */
+  PageKey*  keys;
 
-/**
-* @brief Hash table class to keep track of pages in the buffer pool
-*
-* @warning This class is not threadsafe.
-*/
-class BufHashTbl
-{
- private:
 	/**
-	 *	Size of Hash Table
+	 * Frame number stored in each bucket
 	 */
-  int HTSIZE;
+  FrameId*  frames;
+
 	/**
-	 * Actual Hash table object
+	 * Arrays replaced by grow().  Optimistic lookups may still be reading
+	 * them, so they are only freed with the table.  The table at most
+	 * doubles 31 times.
 	 */
-  hashBucket**  ht;
+  PageKey*  retiredKeys[32];
+  FrameId*  retiredFrames[32];
+  int numRetired;
 
 	/**
-	 * returns hash value between 0 and HTSIZE-1 computed using file and pageNo
+	 * returns hash value between 0 and HTSIZE-1 computed using the page key
 	 *
-	 * @param file   	File object
-	 * @param pageNo  Page number in the file
+	 * @param key  	  Page key
 	 * @return  			Hash value.
 	 */
-  int	 hash(const File* file, const PageId pageNo);
+  int	 hash(const PageKey key) const;
+
+	/**
+	 * returns the index of the bucket holding key, or -1 if absent
+	 *
+	 * @param key  	  Page key
+	 * @return  			Bucket index.
+	 */
+  int	 find(const PageKey key) const;
+
+	/**
+	 * doubles the capacity of the table and rehashes all entries
+	 *
+   * @throws  HashTableException if the larger table could not be allocated
+	 */
+  void grow();
 
  public:
 	/**
+	 * Mixes all bits of a page key into a 64-bit hash value.  Callers
+	 * partitioning pages over several tables should pick the partition from
+	 * the high bits; a table picks the bucket from the low bits.
+	 *
+	 * @param key  	  Page key
+	 * @return  			Hash value.
+	 */
+  static std::uint64_t mix(const PageKey key)
+  {
+    // 64-bit finalizer from MurmurHash3: every key bit affects every hash
+    // bit, so runs of consecutive pages spread over the whole table.
+    std::uint64_t tmp = key;
+    tmp ^= tmp >> 33;
+    tmp *= 0xff51afd7ed558ccdull;
+    tmp ^= tmp >> 33;
+    tmp *= 0xc4ceb9fe1a85ec53ull;
+    tmp ^= tmp >> 33;
+    return tmp;
+  }
+
+	/**
    * Constructor of BufHashTbl class
+	 *
+	 * @param htSize	Expected maximum number of entries, normally the number of frames in the buffer pool
 	 */
 	BufHashTbl(const int htSize);  // constructor
 
@@ -81,7 +135,7 @@ class BufHashTbl
 	 * @param pageNo 	Page number in the file
 	 * @param frameNo Frame number assigned to that page of the file
    * @throws  HashAlreadyPresentException	if the corresponding page already exists in the hash table
-   * @throws  HashTableException (optional) if could not create a new bucket as running of memory
+   * @throws  HashTableException if the table is full and could not grow
 	 */
   void insert(const File* file, const PageId pageNo, const FrameId frameNo);
 
@@ -104,6 +158,49 @@ class BufHashTbl
    * @throws HashNotFoundException if the page entry is not found in the hash table 
 	 */
   void remove(const File* file, const PageId pageNo);  
+
+	/**
+   * Insert entry into hash table mapping key to frameNo.
+   * Non-throwing variant of insert() for the buffer manager hot paths.
+	 *
+	 * @param key   	Page key of the page
+	 * @param frameNo Frame number assigned to that page
+   * @return  false if the corresponding page already exists in the hash table
+   * @throws  HashTableException if the table is full and could not grow
+	 */
+  bool tryInsert(const PageKey key, const FrameId frameNo);
+
+	/**
+   * Check if the page with the given key is currently in the buffer pool.
+   * Non-throwing variant of lookup(); a miss costs only the hash probe.
+	 *
+	 * @param key   	Page key of the page
+	 * @param frameNo Frame number reference, only assigned if the page is found
+   * @return  true if the page entry is found in the hash table
+	 */
+  bool tryLookup(const PageKey key, FrameId &frameNo) const;
+
+	/**
+   * Check if the page with the given key is in the hash table without
+   * holding the partition latch.  Safe to call while another thread updates
+   * the table, but then the result may be wrong: the page can be missed, or
+   * a frame which no longer (or never) held it can be returned.  Callers must
+   * validate the frame against its descriptor.
+	 *
+	 * @param key   	Page key of the page
+	 * @param frameNo Frame number reference, only assigned if the page is found
+   * @return  true if the page entry was found in the hash table
+	 */
+  bool tryLookupOptimistic(const PageKey key, FrameId &frameNo) const;
+
+	/**
+   * Delete the entry for key from hash table.
+   * Non-throwing variant of remove().
+	 *
+	 * @param key   	Page key of the page
+   * @return  false if the page entry is not found in the hash table
+	 */
+  bool tryRemove(const PageKey key);
 };
 
 }
@@ -0,0 +1,205 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <mutex>
+#include "bufPoolSet.h"
+#include "exceptions/pool_exists_exception.h"
+#include "exceptions/pool_not_found_exception.h"
+
+namespace badgerdb
+{
+
+/**
+* Class constructor.  Creates the default pool.
+*/
+BufPoolSet::BufPoolSet(std::uint32_t defaultBufs, ReplacementPolicy policy, std::uint32_t arenaFlags)
+{
+	defaultMgr = new BufMgr(defaultBufs, BufMgr::DEFAULT_PARTITIONS, policy, arenaFlags);
+	pools[DEFAULT_POOL] = defaultMgr;
+}
+
+/**
+* Class destructor.  Destroys the pools, the default pool last.
+*/
+BufPoolSet::~BufPoolSet()
+{
+	for (auto& entry : pools)
+	{
+		if (entry.second != defaultMgr)
+			delete entry.second;
+	}
+	delete defaultMgr;
+}
+
+BufMgr& BufPoolSet::createPool(const std::string& name, std::uint32_t bufs, std::uint32_t partitions,
+                               ReplacementPolicy policy, std::uint32_t arenaFlags, std::uint32_t maxBufs)
+{
+	std::unique_lock<std::shared_mutex> guard(latch);
+	if (pools.count(name))
+		throw PoolExistsException(name);
+	BufMgr* mgr = new BufMgr(bufs, partitions, policy, arenaFlags, maxBufs);
+	pools[name] = mgr;
+	return *mgr;
+}
+
+BufMgr& BufPoolSet::pool(const std::string& name) const
+{
+	std::shared_lock<std::shared_mutex> guard(latch);
+	auto it = pools.find(name);
+	if (it == pools.end())
+		throw PoolNotFoundException(name);
+	return *it->second;
+}
+
+std::vector<std::string> BufPoolSet::poolNames() const
+{
+	std::shared_lock<std::shared_mutex> guard(latch);
+	std::vector<std::string> names;
+	for (auto& entry : pools)
+		names.push_back(entry.first);
+	return names;
+}
+
+BufMgr& BufPoolSet::poolOfLocked(const File* file) const
+{
+	auto it = bindings.find(file->filename());
+	BufMgr* mgr = it == bindings.end() ? defaultMgr : it->second;
+	cachePool(file, mgr);
+	return *mgr;
+}
+
+void BufPoolSet::cachePool(const File* file, BufMgr* mgr) const
+{
+	if (file->slot() >= CACHE_SLOTS)
+		return;
+	// readers check the file before and after reading the pool
+	CachedPool& cached = cache[file->slot()];
+	cached.file.store(File::INVALID_ID);
+	cached.mgr.store(mgr);
+	cached.file.store(file->id());
+}
+
+BufMgr& BufPoolSet::poolOf(const File* file) const
+{
+	if (file->slot() < CACHE_SLOTS)
+	{
+		const CachedPool& cached = cache[file->slot()];
+		if (cached.file.load() == file->id())
+		{
+			BufMgr* mgr = cached.mgr.load();
+			if (cached.file.load() == file->id())
+				return *mgr;
+		}
+	}
+	std::shared_lock<std::shared_mutex> guard(latch);
+	return poolOfLocked(file);
+}
+
+void BufPoolSet::rebind(const File* file, BufMgr* mgr)
+{
+	BufMgr& current = poolOfLocked(file);
+	if (&current == mgr)
+		return;
+	current.flushFile(file);
+	if (mgr == defaultMgr)
+		bindings.erase(file->filename());
+	else
+		bindings[file->filename()] = mgr;
+	cachePool(file, mgr);
+}
+
+void BufPoolSet::bindFile(const File* file, const std::string& name)
+{
+	std::unique_lock<std::shared_mutex> guard(latch);
+	auto it = pools.find(name);
+	if (it == pools.end())
+		throw PoolNotFoundException(name);
+	rebind(file, it->second);
+}
+
+void BufPoolSet::unbindFile(const File* file)
+{
+	std::unique_lock<std::shared_mutex> guard(latch);
+	rebind(file, defaultMgr);
+}
+
+void BufPoolSet::readPage(File* file, const PageId pageNo, Page*& page)
+{
+	poolOf(file).readPage(file, pageNo, page);
+}
+
+void BufPoolSet::readPage(File* file, const PageId pageNo, Page*& page, BufRing &ring)
+{
+	poolOf(file).readPage(file, pageNo, page, ring);
+}
+
+PageHandle BufPoolSet::readPage(File* file, const PageId pageNo)
+{
+	return poolOf(file).readPage(file, pageNo);
+}
+
+void BufPoolSet::readPageOptimistic(File* file, const PageId pageNo, const std::function<void(const Page&)>& reader)
+{
+	poolOf(file).readPageOptimistic(file, pageNo, reader);
+}
+
+void BufPoolSet::readPages(File* file, const std::vector<PageId>& pageNos, std::vector<Page*>& pages)
+{
+	poolOf(file).readPages(file, pageNos, pages);
+}
+
+void BufPoolSet::prefetch(File* file, const std::vector<PageId>& pages)
+{
+	poolOf(file).prefetch(file, pages);
+}
+
+void BufPoolSet::prefetch(File* file, const PageId first, const PageId count)
+{
+	poolOf(file).prefetch(file, first, count);
+}
+
+void BufPoolSet::unPinPage(File* file, const PageId pageNo, const bool dirty)
+{
+	poolOf(file).unPinPage(file, pageNo, dirty);
+}
+
+void BufPoolSet::unPinPages(File* file, const std::vector<PageId>& pageNos, const bool dirty)
+{
+	poolOf(file).unPinPages(file, pageNos, dirty);
+}
+
+void BufPoolSet::allocPage(File* file, PageId &pageNo, Page*& page, const bool deferWrite)
+{
+	poolOf(file).allocPage(file, pageNo, page, deferWrite);
+}
+
+PageHandle BufPoolSet::allocPage(File* file, PageId &pageNo)
+{
+	return poolOf(file).allocPage(file, pageNo);
+}
+
+void BufPoolSet::disposePage(File* file, const PageId pageNo)
+{
+	poolOf(file).disposePage(file, pageNo);
+}
+
+void BufPoolSet::flushFile(const File* file)
+{
+	poolOf(file).flushFile(file);
+}
+
+void BufPoolSet::dropFile(const File* file)
+{
+	poolOf(file).dropFile(file);
+}
+
+BufCounters& BufPoolSet::getFileStats(const File* file)
+{
+	return poolOf(file).getFileStats(file);
+}
+
+}
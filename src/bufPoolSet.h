@@ -0,0 +1,266 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+#include "buffer.h"
+
+namespace badgerdb {
+
+/**
+* @brief Set of independently sized buffer pools with files bound to them.
+*
+* Each pool is a BufMgr of its own, with its own frames, hash table and
+* replacement policy, so pages of one pool never displace pages of another.
+* Files are bound to a pool by name; files which are not bound use the
+* default pool.  The page calls of BufMgr are forwarded to the pool of the
+* file, and the pools can also be used directly through pool().
+*
+* Bindings are kept by file name, so they hold across closing and reopening
+* the file, and should be made before the file's pages are used; a file must
+* not be rebound while other threads use its pages.  The pool of an open file
+* is looked up once and then found by the file's slot without latching, so
+* forwarding a page call costs a few atomic loads.
+*/
+class BufPoolSet
+{
+ private:
+	/**
+   * Number of file slots whose pool is found without latching; files with
+   * higher slots look their pool up under the latch
+	 */
+  static constexpr std::uint32_t CACHE_SLOTS = 256;
+
+	/**
+   * Pool looked up for the open file in a slot
+	 */
+  struct CachedPool
+  {
+		/**
+     * File the pool was looked up for; File::INVALID_ID while it is updated
+		 */
+		std::atomic<FileId> file;
+		std::atomic<BufMgr*> mgr;
+
+		CachedPool() : file(File::INVALID_ID), mgr(NULL) {}
+  };
+
+	/**
+   * Pools by name, the default pool included
+	 */
+  std::map<std::string, BufMgr*> pools;
+
+	/**
+   * Pool of each bound file, by file name
+	 */
+  std::map<std::string, BufMgr*> bindings;
+
+	/**
+   * Pools of the open files, by File::slot()
+	 */
+  mutable CachedPool cache[CACHE_SLOTS];
+
+	/**
+   * The pool of unbound files
+	 */
+  BufMgr* defaultMgr;
+
+	/**
+   * Protects pools and bindings; held exclusively while a file is rebound
+	 */
+  mutable std::shared_mutex latch;
+
+	/**
+   * Returns the pool of the file and remembers it in the file's slot.  The
+   * caller must hold the latch.
+	 */
+  BufMgr& poolOfLocked(const File* file) const;
+
+	/**
+   * Remembers the pool of the file in the file's slot
+	 */
+  void cachePool(const File* file, BufMgr* mgr) const;
+
+	/**
+   * Moves the file to the given pool, first writing back its pages in its
+   * current pool and taking them out of it.  The caller must hold the
+   * latch exclusively.
+	 */
+  void rebind(const File* file, BufMgr* mgr);
+
+ public:
+	/**
+   * Name of the pool of unbound files
+	 */
+  static constexpr const char* DEFAULT_POOL = "default";
+
+	/**
+   * Constructor of BufPoolSet class.  Creates the default pool.
+	 *
+	 * @param defaultBufs  	Number of frames in the default pool
+	 * @param policy   			Page replacement policy of the default pool
+	 * @param arenaFlags   	BufMgr::ARENA_ flags for the memory of the default pool
+	 */
+  BufPoolSet(std::uint32_t defaultBufs, ReplacementPolicy policy = ReplacementPolicy::CLOCK,
+             std::uint32_t arenaFlags = BufMgr::ARENA_HUGE_PAGES);
+
+	/**
+   * Destructor of BufPoolSet class.  Destroys all pools, which writes back
+   * their dirty pages; the files must still be open.
+	 */
+  ~BufPoolSet();
+
+  BufPoolSet(const BufPoolSet &) = delete;
+  BufPoolSet &operator=(const BufPoolSet &) = delete;
+
+	/**
+	 * Creates a pool.  The arguments after the name are those of the BufMgr
+	 * constructor.
+	 *
+	 * @param name   				Name of the pool
+	 * @param bufs   				Number of frames in the pool
+	 * @param partitions   	Number of independently latched hash table partitions
+	 * @param policy   			Page replacement policy
+	 * @param arenaFlags   	BufMgr::ARENA_ flags for the memory of the pool
+	 * @param maxBufs   		Number of frames resize() may grow the pool to; bufs if smaller
+	 * @return The new pool
+   * @throws  PoolExistsException If there is a pool of that name already
+	 */
+  BufMgr& createPool(const std::string& name, std::uint32_t bufs,
+                     std::uint32_t partitions = BufMgr::DEFAULT_PARTITIONS,
+                     ReplacementPolicy policy = ReplacementPolicy::CLOCK,
+                     std::uint32_t arenaFlags = BufMgr::ARENA_HUGE_PAGES, std::uint32_t maxBufs = 0);
+
+	/**
+	 * Returns the pool of the given name.
+	 *
+	 * @param name   				Name of the pool
+   * @throws  PoolNotFoundException If there is no pool of that name
+	 */
+  BufMgr& pool(const std::string& name) const;
+
+	/**
+	 * Returns the pool of unbound files.
+	 */
+  BufMgr& defaultPool() const { return *defaultMgr; }
+
+	/**
+	 * Returns the names of all pools.
+	 */
+  std::vector<std::string> poolNames() const;
+
+	/**
+	 * Binds the file to the named pool.  Pages of the file which are in
+	 * another pool are written back and taken out of it first.
+	 *
+	 * @param file   	File object
+	 * @param name   	Name of the pool
+   * @throws  PoolNotFoundException If there is no pool of that name
+   * @throws  PagePinnedException If a page of the file is pinned in its current pool;
+   *          the file then stays bound to that pool
+	 */
+  void bindFile(const File* file, const std::string& name);
+
+	/**
+	 * Binds the file back to the default pool, like bindFile(file, DEFAULT_POOL).
+	 *
+	 * @param file   	File object
+   * @throws  PagePinnedException If a page of the file is pinned in its current pool
+	 */
+  void unbindFile(const File* file);
+
+	/**
+	 * Returns the pool the file is bound to.
+	 *
+	 * @param file   	File object
+	 */
+  BufMgr& poolOf(const File* file) const;
+
+	/**
+	 * BufMgr::readPage() in the pool of the file.
+	 */
+  void readPage(File* file, const PageId PageNo, Page*& page);
+
+	/**
+	 * BufMgr::readPage() through a ring, in the pool of the file.  The ring
+	 * must belong to that pool.
+	 */
+  void readPage(File* file, const PageId PageNo, Page*& page, BufRing &ring);
+
+	/**
+	 * BufMgr::readPage() returning a handle, in the pool of the file.
+	 */
+  PageHandle readPage(File* file, const PageId PageNo);
+
+	/**
+	 * BufMgr::readPageOptimistic() in the pool of the file.
+	 */
+  void readPageOptimistic(File* file, const PageId PageNo, const std::function<void(const Page&)>& reader);
+
+	/**
+	 * BufMgr::readPages() in the pool of the file.
+	 */
+  void readPages(File* file, const std::vector<PageId>& PageNos, std::vector<Page*>& pages);
+
+	/**
+	 * BufMgr::prefetch() in the pool of the file.
+	 */
+  void prefetch(File* file, const std::vector<PageId>& pages);
+
+	/**
+	 * BufMgr::prefetch() of a range of pages, in the pool of the file.
+	 */
+  void prefetch(File* file, const PageId first, const PageId count);
+
+	/**
+	 * BufMgr::unPinPage() in the pool of the file.
+	 */
+  void unPinPage(File* file, const PageId PageNo, const bool dirty);
+
+	/**
+	 * BufMgr::unPinPages() in the pool of the file.
+	 */
+  void unPinPages(File* file, const std::vector<PageId>& PageNos, const bool dirty);
+
+	/**
+	 * BufMgr::allocPage() in the pool of the file.
+	 */
+  void allocPage(File* file, PageId &PageNo, Page*& page, const bool deferWrite = false);
+
+	/**
+	 * BufMgr::allocPage() returning a handle, in the pool of the file.
+	 */
+  PageHandle allocPage(File* file, PageId &PageNo);
+
+	/**
+	 * BufMgr::disposePage() in the pool of the file.
+	 */
+  void disposePage(File* file, const PageId PageNo);
+
+	/**
+	 * BufMgr::flushFile() in the pool of the file.
+	 */
+  void flushFile(const File* file);
+
+	/**
+	 * BufMgr::dropFile() in the pool of the file.
+	 */
+  void dropFile(const File* file);
+
+	/**
+	 * BufMgr::getFileStats() in the pool of the file.
+	 */
+  BufCounters& getFileStats(const File* file);
+};
+
+}
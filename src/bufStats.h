@@ -0,0 +1,360 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+* @brief Counters of buffer pool events, for the whole pool or one file
+*
+* Each event costs an atomic add on the counters of the pool and one on those
+* of the file.  The counters are not latched together, so a set of counters
+* read while the pool is busy may be slightly out of step.
+*/
+struct BufCounters
+{
+	/**
+   * Total number of accesses to buffer pool (hits, misses and allocs)
+	 */
+  std::atomic<std::uint64_t> accesses;
+
+	/**
+   * Number of accesses which did not find the page in the buffer pool
+	 */
+  std::atomic<std::uint64_t> misses;
+
+	/**
+   * Number of pages allocated through the buffer pool
+	 */
+  std::atomic<std::uint64_t> allocations;
+
+	/**
+   * Number of pages read from disk by misses (including allocs, but not deferred ones)
+	 */
+  std::atomic<std::uint64_t> diskreads;
+
+	/**
+   * Number of pages read from disk by prefetch()
+	 */
+  std::atomic<std::uint64_t> prefetchreads;
+
+	/**
+   * Number of pages written back to disk
+	 */
+  std::atomic<std::uint64_t> diskwrites;
+
+	/**
+   * Number of pages written back by the background writer (included in diskwrites)
+	 */
+  std::atomic<std::uint64_t> bgwrites;
+
+	/**
+   * Number of victims which were clean when a miss evicted them
+	 */
+  std::atomic<std::uint64_t> cleanevictions;
+
+	/**
+   * Number of victims which a miss had to write back before evicting them
+	 */
+  std::atomic<std::uint64_t> dirtyevictions;
+
+	/**
+   * Number of times the replacement policy was asked for a victim
+	 */
+  std::atomic<std::uint64_t> sweeps;
+
+	/**
+   * Number of frames the replacement policy offered during those sweeps
+	 */
+  std::atomic<std::uint64_t> sweepsteps;
+
+	/**
+   * Number of pages disposed
+	 */
+  std::atomic<std::uint64_t> disposes;
+
+	/**
+   * Number of flushFile() calls
+	 */
+  std::atomic<std::uint64_t> flushes;
+
+	/**
+   * Clear all values
+	 */
+  void clear()
+  {
+		accesses = misses = allocations = 0;
+		diskreads = prefetchreads = diskwrites = bgwrites = 0;
+		cleanevictions = dirtyevictions = sweeps = sweepsteps = 0;
+		disposes = flushes = 0;
+  }
+
+	/**
+   * Copy all values of other
+	 */
+  void copyFrom(const BufCounters& other)
+  {
+		const std::memory_order relaxed = std::memory_order_relaxed;
+		// an access is counted before its miss or allocation, so these are
+		// read first, in order, for the copy not to show more misses than accesses
+		const std::uint64_t missCount = other.misses;
+		const std::uint64_t allocationCount = other.allocations;
+		const std::uint64_t accessCount = other.accesses;
+		misses.store(missCount, relaxed);
+		allocations.store(allocationCount, relaxed);
+		accesses.store(accessCount, relaxed);
+		diskreads.store(other.diskreads.load(relaxed), relaxed);
+		prefetchreads.store(other.prefetchreads.load(relaxed), relaxed);
+		diskwrites.store(other.diskwrites.load(relaxed), relaxed);
+		bgwrites.store(other.bgwrites.load(relaxed), relaxed);
+		cleanevictions.store(other.cleanevictions.load(relaxed), relaxed);
+		dirtyevictions.store(other.dirtyevictions.load(relaxed), relaxed);
+		sweeps.store(other.sweeps.load(relaxed), relaxed);
+		sweepsteps.store(other.sweepsteps.load(relaxed), relaxed);
+		disposes.store(other.disposes.load(relaxed), relaxed);
+		flushes.store(other.flushes.load(relaxed), relaxed);
+  }
+
+	/**
+   * Number of accesses which found the page in the buffer pool; not counted
+   * separately, to keep hits down to a single atomic add
+	 */
+  std::uint64_t hits() const
+  {
+		// read before accesses, see copyFrom()
+		const std::uint64_t missCount = misses;
+		const std::uint64_t other = missCount + allocations;
+		const std::uint64_t total = accesses;
+		return total > other ? total - other : 0;
+  }
+
+	/**
+   * Accesses which read a page rather than allocate one
+	 */
+  std::uint64_t reads() const
+  {
+		const std::uint64_t allocated = allocations;
+		const std::uint64_t total = accesses;
+		return total > allocated ? total - allocated : 0;
+  }
+
+	/**
+   * Fraction of accesses which found the page in the buffer pool
+	 */
+  double hitRatio() const
+  {
+		const std::uint64_t found = hits();
+		const std::uint64_t total = accesses;
+		return total > 0 ? (double)std::min(found, total) / total : 0.0;
+  }
+
+	/**
+   * Average number of frames a sweep for a victim looked at
+	 */
+  double stepsPerSweep() const
+  {
+		const std::uint64_t total = sweeps;
+		return total > 0 ? (double)sweepsteps / total : 0.0;
+  }
+
+	/**
+   * Constructor of BufCounters class
+	 */
+  BufCounters()
+  {
+		clear();
+  }
+};
+
+/**
+* @brief Counters of one file in the buffer pool
+*/
+struct FileCounters : BufCounters
+{
+	/**
+   * File the counters belong to; 0 while the slot is unused
+	 */
+  std::atomic<FileId> file;
+
+	/**
+   * Number of frames whose pages are counted here; not a counter of events,
+   * so clear() leaves it alone
+	 */
+  std::atomic<std::uint32_t> frames;
+
+  FileCounters() : file(0), frames(0) {}
+};
+
+/**
+* @brief Class to maintain statistics of buffer usage
+*
+* The totals of the pool are the counters of BufStats itself.  Each file also
+* has a set of counters of its own, in the slot of a fixed table which
+* File::slot() gives it, so a file's counters are found with a single
+* comparison; files with slots beyond the table share the counters of
+* otherFiles.  File slots are reused, so the counters of a slot are taken
+* over by the next file which uses it, and cleared unless it is the same file
+* reopened.  While pages of the previous file are still in the pool the slot
+* is not taken over, and the new file is counted with otherFiles.  Evictions
+* and write-backs are counted for the file whose page was written or evicted;
+* sweeps are only counted for the pool.
+*/
+struct BufStats : BufCounters
+{
+	/**
+   * Number of files counted separately
+	 */
+  static const std::uint32_t FILE_SLOTS = 64;
+
+	/**
+   * Counters of the files
+	 */
+  FileCounters files[FILE_SLOTS];
+
+	/**
+   * Counters of the files which did not get a slot
+	 */
+  FileCounters otherFiles;
+
+	/**
+   * Names of the files in files[], for reports; protected by namesLatch
+	 */
+  std::string names[FILE_SLOTS];
+  mutable std::mutex namesLatch;
+
+	/**
+   * Returns the counters of the file, taking its slot over for it the first
+   * time it is counted.
+	 *
+	 * @param file   	File ID, not 0
+	 * @param slot   	Slot of the file
+	 * @param name   	Name of the file
+	 */
+  FileCounters& ofFile(const FileId file, const std::uint32_t slot, const std::string& name)
+  {
+		if (slot < FILE_SLOTS && files[slot].file.load(std::memory_order_acquire) == file)
+			return files[slot];
+		return claimSlot(file, slot, name);
+  }
+
+	/**
+   * Takes the slot over for the file, if it can be; see ofFile().
+	 */
+  FileCounters& claimSlot(const FileId file, const std::uint32_t slot, const std::string& name)
+  {
+		if (slot >= FILE_SLOTS)
+			return otherFiles;
+		std::lock_guard<std::mutex> guard(namesLatch);
+		FileCounters& counters = files[slot];
+		if (counters.file.load(std::memory_order_relaxed) == file)
+			return counters;
+		if (names[slot] != name)
+		{
+			// frames of the previous file still count their evictions here
+			if (counters.frames.load(std::memory_order_acquire) > 0)
+				return otherFiles;
+			counters.clear();
+			names[slot] = name;
+		}
+		counters.file.store(file, std::memory_order_release);
+		return counters;
+  }
+
+	/**
+   * Returns the name recorded for the file in the given slot.
+	 */
+  std::string nameOf(const std::uint32_t slot) const
+  {
+		std::lock_guard<std::mutex> guard(namesLatch);
+		return names[slot];
+  }
+
+	/**
+   * Clear all values, of the pool and of every file; the files keep their
+   * slots
+	 */
+  void clear()
+  {
+		BufCounters::clear();
+		for (std::uint32_t slot = 0; slot < FILE_SLOTS; slot++)
+			files[slot].clear();
+		otherFiles.clear();
+  }
+
+  BufStats() {}
+};
+
+/**
+* @brief Layout of the shared memory object which BufMgr::exportStats() keeps
+* up to date and badgerdb_stat reads.
+*
+* The writer makes sequence odd while it updates the region and even again
+* when it is done; a reader copies the region and retries if sequence was odd
+* or changed meanwhile.
+*/
+struct BufStatsRegion
+{
+	/**
+   * Value of magic in a region of this layout
+	 */
+  static const std::uint64_t MAGIC = 0x6267646273746174ULL;
+
+	/**
+   * Length of the file names, including the terminating NUL
+	 */
+  static const std::uint32_t NAME_LEN = 64;
+
+	/**
+   * Counters and name of one file
+	 */
+  struct FileEntry
+  {
+		FileId file;
+		char name[NAME_LEN];
+		BufCounters counters;
+  };
+
+  std::uint64_t magic;
+  std::atomic<std::uint64_t> sequence;
+
+	/**
+   * Process which exports the region
+	 */
+  std::uint32_t pid;
+
+	/**
+   * Number of frames in the buffer pool
+	 */
+  std::uint32_t frames;
+
+	/**
+   * Time of the last update, in milliseconds since the epoch
+	 */
+  std::uint64_t updatedMs;
+
+	/**
+   * Counters of the whole pool
+	 */
+  BufCounters totals;
+
+	/**
+   * Number of valid entries in files; the last one may be the files without a slot
+	 */
+  std::uint32_t numFiles;
+  FileEntry files[BufStats::FILE_SLOTS + 1];
+};
+
+}
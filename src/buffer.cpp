@@ -7,14 +7,23 @@
  * 
  */
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <exception>
 #include <memory>
+#include <new>
 #include <iostream>
+#include <system_error>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #include "buffer.h"
 #include "exceptions/buffer_exceeded_exception.h"
 #include "exceptions/page_not_pinned_exception.h"
 #include "exceptions/page_pinned_exception.h"
 #include "exceptions/bad_buffer_exception.h"
-#include "exceptions/hash_not_found_exception.h"
+#include "exceptions/hash_already_present_exception.h"
 
 namespace badgerdb
 {
@@ -24,23 +33,64 @@ namespace badgerdb
 * Allocates an array for the buffer pool with bufs page frames and a corresponding
 * BufDesc table
 */
-BufMgr::BufMgr(std::uint32_t bufs)
-	: numBufs(bufs)
+BufMgr::BufMgr(std::uint32_t bufs, std::uint32_t partitions, ReplacementPolicy policy,
+               std::uint32_t arenaFlags, std::uint32_t maxBufs)
+	: numBufs(bufs), maxBufs(maxBufs > bufs ? maxBufs : bufs),
+	  numPartitions(partitions > 0 ? partitions : 1), arenaFlags(arenaFlags)
 {
-	bufDescTable = new BufDesc[bufs];
+	// descriptors of the frames resize() may add are there from the start
+	bufDescTable = new BufDesc[this->maxBufs];
 
-	for (FrameId i = 0; i < bufs; i++)
+	for (FrameId i = 0; i < this->maxBufs; i++)
 	{
 		bufDescTable[i].frameNo = i;
 		bufDescTable[i].valid = false;
 	}
 
-	bufPool = new Page[bufs];
+	mapArena(bufs);
+
+	// allocate the buffer hash table; each partition is sized for twice its
+	// expected share of the frames and grows if it gets more than that
+	hashTable = new BufHashTbl*[numPartitions];
+	hashLatch = new std::mutex[numPartitions];
+	for (std::uint32_t i = 0; i < numPartitions; i++)
+		hashTable[i] = new BufHashTbl(2 * bufs / numPartitions + 8);
+
+	// no frame holds a page yet, so no file has any frames
+	fileNext = new FrameId[this->maxBufs];
+	filePrev = new FrameId[this->maxBufs];
+	fileOf = new FileId[this->maxBufs];
+	fileStatsOf = new FileCounters*[this->maxBufs];
+	for (FrameId i = 0; i < this->maxBufs; i++)
+	{
+		fileOf[i] = File::INVALID_ID;
+		fileStatsOf[i] = NULL;
+	}
+	fileHeads = new BufHashTbl(64);
+
+	// every frame starts out invalid, so all of them are free and unpinned;
+	// push them in reverse so frames are handed out in frame order
+	freeList = new FrameId[this->maxBufs];
+	freeCount = 0;
+	for (FrameId i = bufs; i > 0; i--)
+		freeList[freeCount++] = i - 1;
+	numUnpinned = bufs;
+
+	replacer = Replacer::create(policy, bufs, this->maxBufs);
+
+	bgStop = false;
+	bgCleanTarget = 0;
+	bgIntervalMs = 0;
+	bgFrames = new FrameId[this->maxBufs];
 
-	int htsize = ((((int)(bufs * 1.2)) * 2) / 2) + 1;
-	hashTable = new BufHashTbl(htsize); // allocate the buffer hash table
+	prefetchesPending = 0;
+	prefetchStop = false;
 
-	clockHand = bufs - 1;
+	exportStop = false;
+	exportIntervalMs = 0;
+	exportRegion = NULL;
+
+	syncPolicy = SyncPolicy::FLUSH;
 }
 
 /**
@@ -48,25 +98,93 @@ BufMgr::BufMgr(std::uint32_t bufs)
 */
 BufMgr::~BufMgr()
 {
-    // Flushes out all dirty pages
-    for(int i = 0; i < numBufs; i++){
+    stopBgWriter();
+    stopPrefetcher();
+    // Flushes out all dirty pages a file at a time, then syncs every file
+    // written to; files are written back by up to FLUSH_THREADS threads
+    std::vector<std::pair<File*, std::vector<const Page*> > > written;
+    for(std::uint32_t i = 0; i < numBufs; i++){
         BufDesc* frame = &bufDescTable[i];
-        if(frame->dirty){
-          // flush to disk
-          frame->file->writePage(*(bufPool + frame->frameNo));
+        if(frame->valid && frame->dirty){
+          std::size_t f = 0;
+          while(f < written.size() && written[f].first->id() != frame->file->id())
+            f++;
+          if(f == written.size())
+            written.push_back(std::make_pair(frame->file, std::vector<const Page*>()));
+          written[f].second.push_back(bufPool + frame->frameNo);
         }
     }
+    std::atomic<std::size_t> nextFile(0);
+    auto writeFiles = [&]() {
+        for(std::size_t f = nextFile++; f < written.size(); f = nextFile++){
+          // a destructor cannot throw, nor can a thread; the failure is
+          // reported instead and the other files are still written
+          try {
+            written[f].first->writePages(written[f].second);
+            bufStats.diskwrites += written[f].second.size();
+            statsOf(written[f].first).diskwrites += written[f].second.size();
+            written[f].first->sync(syncPolicy);
+          } catch (const std::exception& e) {
+            std::cerr << "BufMgr: " << e.what() << "\n";
+          }
+        }
+    };
+    std::vector<std::thread> flushers;
+    for(std::size_t t = 1; t < written.size() && t < FLUSH_THREADS; t++)
+        flushers.emplace_back(writeFiles);
+    writeFiles();
+    for(std::thread& flusher : flushers)
+        flusher.join();
+    stopExportStats();
     // Deallocate
-	delete[] bufPool;
+	delete replacer;
+	munmap(arena, arenaBytes);
     delete[] bufDescTable;
+    delete[] freeList;
+    delete[] bgFrames;
+    delete[] fileNext;
+    delete[] filePrev;
+    delete[] fileOf;
+    delete[] fileStatsOf;
+    delete fileHeads;
+    for(std::uint32_t i = 0; i < numPartitions; i++)
+        delete hashTable[i];
+    delete[] hashTable;
+    delete[] hashLatch;
 }
 
 /**
- * Advance clock to next frame in the buffer pool
- */
-void BufMgr::advanceClock()
+* Maps the arena for the buffer pool and constructs the frames in it.  Room
+* for maxBufs frames is mapped; the memory of frames which are never used is
+* never touched, so it costs address space only.
+*
+* @param bufs        Number of frames
+*/
+void BufMgr::mapArena(std::uint32_t bufs)
 {
-	clockHand = (clockHand + 1) % numBufs;
+	// huge pages only back mappings aligned to the huge page size, so map
+	// enough to align the pool to it
+	const std::size_t hugePage = 2 << 20;
+	const std::size_t poolBytes = (std::size_t)(maxBufs > 0 ? maxBufs : 1) * Page::SIZE;
+	arenaBytes = poolBytes + ((arenaFlags & ARENA_HUGE_PAGES) ? hugePage : 0);
+	arena = mmap(NULL, arenaBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (arena == MAP_FAILED)
+		throw std::bad_alloc();
+
+	char* start = static_cast<char*>(arena);
+	if (arenaFlags & ARENA_HUGE_PAGES)
+	{
+		start += (hugePage - (std::uintptr_t)start % hugePage) % hugePage;
+#ifdef MADV_HUGEPAGE
+		madvise(start, poolBytes, MADV_HUGEPAGE);	// only a hint
+#endif
+	}
+	if (arenaFlags & ARENA_LOCKED)
+		mlock(start, (std::size_t)bufs * Page::SIZE);	// best effort, limited by RLIMIT_MEMLOCK
+
+	bufPool = reinterpret_cast<Page*>(start);
+	for (FrameId i = 0; i < bufs; i++)
+		new (&bufPool[i]) Page();
 }
 
 /**
@@ -77,51 +195,339 @@ void BufMgr::advanceClock()
 */
 void BufMgr::allocBuf(FrameId &frame)
 {
- // checking for if all pages are arepinned
-  bool unpinned = false;
-  for(int i = 0; i < numBufs; i++){
-    if(bufDescTable[i].pinCnt <= 0){
-      // found an unpinned frame
-      unpinned = true;
-      break;
+  std::uint32_t failedSweeps = 0;
+  while(true){
+    // checking for if all pages are pinned
+    if(numUnpinned.load() == 0)
+      throw BufferExceededException();
+
+    // invalid frames are always on the free list, hand one out directly;
+    // it is pinned before the latch is dropped, so resize() never sees a
+    // frame which is neither free nor pinned
+    {
+      std::lock_guard<std::mutex> freeGuard(freeLatch);
+      if(freeCount > 0){
+        frame = freeList[--freeCount];
+        std::lock_guard<SpinLatch> guard(bufDescTable[frame].latch);
+        bufDescTable[frame].Pin();
+        numUnpinned--;
+        return;
+      }
     }
-  }
-  if(unpinned == false) 
-  throw BufferExceededException();
 
-  //unsigned int startHand = clockHand;
-  while(true){
-    advanceClock();
-    BufDesc* frameInfo = &bufDescTable[clockHand];
-    if(frameInfo->valid){
-      if(frameInfo->refbit){
-	frameInfo->refbit = false;
-	continue;
-      } else {
-	if(frameInfo->pinCnt > 0){
-	  continue;
-	} else {
-	  if(frameInfo->dirty){
-	    // flush page to disk
-          // frameInfo->file->writePage(frameInfo->pageNo, *(bufPool + frameInfo->frameNo));
-          // private?
-           frameInfo->file->writePage(*(bufPool + frameInfo->frameNo));
-	  }
-	  break;
-	}
+    // no free frame: ask the replacement policy for a victim.  If other
+    // threads pin every candidate concurrently, start over and re-check the
+    // free list and the unpinned count.
+    FrameId hand;
+    std::uint32_t gen = 0;
+    bool dirty = false;
+    File* file = NULL;
+    FileCounters* stats = NULL;
+    PageKey key = 0;
+    std::uint32_t steps = 0;
+    const bool claimed = replacer->victim(hand, [&](const FrameId candidate) {
+      steps++;
+      BufDesc* frameInfo = &bufDescTable[candidate];
+      std::lock_guard<SpinLatch> guard(frameInfo->latch);
+      // free frames belong to the free list, pinned ones include frames
+      // being read or claimed by another thread, and frames resize() is
+      // taking out of the pool are left to it
+      if(!frameInfo->valid || frameInfo->pinCnt > 0 || candidate >= numBufs)
+        return false;
+      // claim the frame with a pin so nobody else evicts it
+      frameInfo->Pin();
+      numUnpinned--;
+      gen = frameInfo->generation;
+      dirty = frameInfo->dirty;
+      frameInfo->dirty = false;
+      file = frameInfo->file;
+      stats = fileStatsOf[candidate];
+      key = frameInfo->key;
+      return true;
+    });
+    bufStats.sweeps++;
+    bufStats.sweepsteps += steps;
+    if(!claimed){
+      // only CLOCK sweeps frames of rings; the other policies only learn of
+      // them once a ring hands them over, so the unpinned frames may all be
+      // in rings
+      if(adoptIdleRingFrame())
+        continue;
+      // other threads may hold every frame for a moment, but not for long
+      if(++failedSweeps >= MAX_FAILED_SWEEPS)
+        throw BufferExceededException();
+      std::this_thread::yield();
+      continue;
+    }
+
+    // the file may be closed by now if the page is clean, so its counters
+    // are those the page was counted with
+    BufCounters& fileStats = stats != NULL ? *stats : bufStats.otherFiles;
+
+    BufDesc* frameInfo = &bufDescTable[hand];
+    if(dirty){
+      // flush page to disk
+      try {
+        file->writePage(bufPool[hand]);
+      } catch (...) {
+        {
+          std::lock_guard<SpinLatch> guard(frameInfo->latch);
+          if(frameInfo->generation == gen)
+            frameInfo->dirty = true;
+        }
+        releaseBuf(hand, gen);
+        throw;
       }
-    } else {
-      break;
+      bufStats.diskwrites++;
+      fileStats.diskwrites++;
+      // the background writer, if any, is falling behind
+      bgWake.notify_one();
+    }
+    // set frame
+    if(evictBuf(hand, gen)){
+      if(dirty){
+        bufStats.dirtyevictions++;
+        fileStats.dirtyevictions++;
+      }else{
+        bufStats.cleanevictions++;
+        fileStats.cleanevictions++;
+      }
+      frame = hand;
+      return;
+    }
+  }
+}
+
+/**
+* Hand an unpinned frame of a ring over to the replacement policy, so that
+* it can be evicted.
+*
+* @return True if a frame was handed over
+*/
+bool BufMgr::adoptIdleRingFrame()
+{
+  const std::uint32_t frames = numBufs;
+  for(FrameId i = 0; i < frames; i++){
+    BufDesc* frameInfo = &bufDescTable[i];
+    PageKey key;
+    {
+      std::lock_guard<SpinLatch> guard(frameInfo->latch);
+      if(!frameInfo->valid || !frameInfo->inRing || frameInfo->pinCnt > 0)
+        continue;
+      frameInfo->inRing = false;
+      key = frameInfo->key;
+    }
+    replacer->load(i, key);
+    return true;
+  }
+  return false;
+}
+
+/**
+* Clear a frame and put it on the free list.  The frame must not be in the
+* hash table and no other thread may hold a pin on it.  Frames which resize()
+* is taking out of the pool stay off the list for it to collect.
+*
+* @param frame   Frame ID of the frame to release
+*/
+void BufMgr::freeBuf(const FrameId frame)
+{
+  replacer->remove(frame);
+  std::lock_guard<std::mutex> freeGuard(freeLatch);
+  {
+    std::lock_guard<SpinLatch> guard(bufDescTable[frame].latch);
+    if(bufDescTable[frame].pinCnt > 0)
+      numUnpinned++;
+    unlinkFrame(frame);
+    bufDescTable[frame].Clear();
+  }
+  if(frame < numBufs)
+    freeList[freeCount++] = frame;
+}
+
+/**
+* Take the frame's page out of the pool, unless somebody else pinned or
+* dirtied it since the caller pinned it.
+*
+* @param frame   Frame ID of the frame
+* @param gen     Generation of the frame when it was pinned
+* @return True if the page was removed and the frame is now reserved for the caller
+*/
+bool BufMgr::evictBuf(const FrameId frame, const std::uint32_t gen)
+{
+  BufDesc* frameInfo = &bufDescTable[frame];
+  PageKey key;
+  {
+    // the key cannot change while we hold a pin, but read it under the latch
+    std::lock_guard<SpinLatch> guard(frameInfo->latch);
+    if(frameInfo->generation != gen)
+      return false;
+    key = frameInfo->key;
+  }
+
+  const std::uint32_t part = partitionOf(key);
+  {
+    std::lock_guard<std::mutex> partGuard(hashLatch[part]);
+    std::lock_guard<SpinLatch> guard(frameInfo->latch);
+    if(frameInfo->generation != gen)
+      return false;  // page was disposed meanwhile, and our pin with it
+    if(frameInfo->pinCnt > 1 || frameInfo->dirty){
+      // somebody is using the page again, leave it in the pool
+      if(frameInfo->Unpin())
+        numUnpinned++;
+      return false;
+    }
+    hashTable[part]->tryRemove(key);
+    unlinkFrame(frame);
+    frameInfo->Clear();
+    frameInfo->Pin();
+  }
+  // the frame is reserved for the caller, so nobody can load it before this
+  replacer->evict(frame);
+  return true;
+}
+
+/**
+* Drop a pin which the caller took while the frame's generation was gen.
+*
+* @param frame   Frame ID of the frame
+* @param gen     Generation of the frame when it was pinned
+* @param dirty   True if the page needs to be marked dirty
+* @param key     If not NULL, the key of the page is returned via this pointer
+* @return True if the pin was dropped
+*/
+bool BufMgr::releaseBuf(const FrameId frame, const std::uint32_t gen, const bool dirty, PageKey* key)
+{
+  std::lock_guard<SpinLatch> guard(bufDescTable[frame].latch);
+  if(bufDescTable[frame].generation != gen)
+    return false;
+  if(dirty)
+    bufDescTable[frame].dirty = true;
+  if(key != NULL)
+    *key = bufDescTable[frame].key;
+  if(bufDescTable[frame].Unpin())
+    numUnpinned++;
+  return true;
+}
+
+/**
+* Wraps the pin which readPage() or allocPage() took on page in a handle.
+*
+* @param page    Pinned page in the buffer pool
+* @return Handle owning the pin
+*/
+PageHandle BufMgr::handleOf(Page *page)
+{
+  const FrameId frame = page - bufPool;
+  std::uint32_t gen;
+  {
+    // the pin keeps the generation from changing
+    std::lock_guard<SpinLatch> guard(bufDescTable[frame].latch);
+    gen = bufDescTable[frame].generation;
+  }
+  return PageHandle(this, page, frame, gen);
+}
+
+/**
+* Finish a read started by readPage: wake up waiting threads and, if the read
+* failed, take the page back out of the hash table.
+*
+* @param frame   Frame ID of the frame the page was read into
+* @param ok      True if the read succeeded
+*/
+void BufMgr::finishRead(const FrameId frame, const bool ok)
+{
+  BufDesc* frameInfo = &bufDescTable[frame];
+  bool unused = false;
+  if(ok){
+    std::lock_guard<SpinLatch> guard(frameInfo->latch);
+    frameInfo->ioInProgress = false;
+  } else {
+    PageKey key;
+    {
+      std::lock_guard<SpinLatch> guard(frameInfo->latch);
+      key = frameInfo->key;
     }
+    const std::uint32_t part = partitionOf(key);
+    std::lock_guard<std::mutex> partGuard(hashLatch[part]);
+    std::lock_guard<SpinLatch> guard(frameInfo->latch);
+    hashTable[part]->tryRemove(key);
+    // waiters still hold pins; the last one to drop its pin frees the frame,
+    // keeping the pin until freeBuf so the frame is never idle in between
+    frameInfo->valid = false;
+    frameInfo->ioInProgress = false;
+    if(frameInfo->pinCnt == 1)
+      unused = true;
+    else
+      frameInfo->Unpin();
+  }
+
+  const std::uint32_t stripe = frame % IO_STRIPES;
+  {
+    std::lock_guard<std::mutex> ioGuard(ioLatch[stripe]);
   }
-  // set frame
-  if(bufDescTable[clockHand].valid){
-    hashTable->remove(bufDescTable[clockHand].file, bufDescTable[clockHand].pageNo);
+  ioDone[stripe].notify_all();
+
+  if(unused)
+    freeBuf(frame);
+}
+
+/**
+* Wait until a read into the frame has finished.
+*
+* @param frame   Frame ID of the frame
+* @param gen     Generation of the frame when it was pinned
+* @return True if the frame now holds the page
+*/
+bool BufMgr::waitForRead(const FrameId frame, const std::uint32_t gen)
+{
+  BufDesc* frameInfo = &bufDescTable[frame];
+  {
+    const std::uint32_t stripe = frame % IO_STRIPES;
+    std::unique_lock<std::mutex> ioGuard(ioLatch[stripe]);
+    ioDone[stripe].wait(ioGuard, [frameInfo] { return !frameInfo->ioInProgress.load(); });
   }
-  bufDescTable[clockHand].Clear();
-  frame = bufDescTable[clockHand].frameNo;
-  return;
 
+  {
+    std::lock_guard<SpinLatch> guard(frameInfo->latch);
+    if(frameInfo->generation != gen)
+      return false;  // page was disposed meanwhile, and our pin with it
+    if(frameInfo->valid)
+      return true;
+    // the read failed; the last one to drop its pin frees the frame
+    if(frameInfo->pinCnt > 1){
+      frameInfo->Unpin();
+      return false;
+    }
+  }
+  freeBuf(frame);
+  return false;
+}
+
+/**
+* Pin the frame holding the page with the given key, if there is one.  The
+* caller must hold the latch of the key's hash partition.
+*/
+bool BufMgr::pinResident(const PageKey key, File* file, FrameId &frame, std::uint32_t &gen, bool &reading,
+                         const bool ringRead, bool &adopted)
+{
+	if (!hashTable[partitionOf(key)]->tryLookup(key, frame))
+		return false;
+
+	BufDesc* frameInfo = &bufDescTable[frame];
+	std::lock_guard<SpinLatch> guard(frameInfo->latch);
+	//Increment pin count
+	if (frameInfo->Pin())
+		numUnpinned--;
+	//the caller's File object is known to be open, write back through it
+	frameInfo->file = file;
+	gen = frameInfo->generation;
+	reading = frameInfo->ioInProgress;
+	//somebody besides the scan wants the page, so the ring must not recycle it
+	adopted = !ringRead && frameInfo->inRing;
+	if (adopted)
+		frameInfo->inRing = false;
+	return true;
 }
 
 /**
@@ -135,25 +541,505 @@ void BufMgr::allocBuf(FrameId &frame)
 */
 void BufMgr::readPage(File *file, const PageId pageNo, Page *&page)
 {
+	fetchPage(file, pageNo, page, NULL);
+	if (tracer.enabled())
+		tracer.record(TraceOp::READ, file->id(), pageNo);
+	if (reuseTracker.enabled())
+		reuseTracker.record(makePageKey(file->id(), pageNo));
+}
+
+/**
+* Reads the given page, reading it from disk into a frame of the ring if necessary.
+*
+* @param file    File object
+* @param PageNo  Page number in the file to be read
+* @param page  	 Reference to page pointer. Used to fetch the Page object in which requested page from file is read in.
+* @param ring    Ring of frames the scan is confined to
+*/
+void BufMgr::readPage(File *file, const PageId pageNo, Page *&page, BufRing &ring)
+{
+	fetchPage(file, pageNo, page, &ring);
+	if (tracer.enabled())
+		tracer.record(TraceOp::READ, file->id(), pageNo);
+	if (reuseTracker.enabled())
+		reuseTracker.record(makePageKey(file->id(), pageNo));
+}
+
+/**
+* Common part of both readPage() variants.
+*
+* @param file    File object
+* @param PageNo  Page number in the file to be read
+* @param page  	 Reference to page pointer
+* @param ring    Ring to read the page through, or NULL
+*/
+void BufMgr::fetchPage(File *file, const PageId pageNo, Page *&page, BufRing *ring)
+{
+	const PageKey key = makePageKey(file->id(), pageNo);
+	const std::uint32_t part = partitionOf(key);
+	BufCounters& fileStats = statsOf(file);
+	bufStats.accesses++;
+	fileStats.accesses++;
+
+	while (true)
+	{
+		FrameId frameNo;
+		std::uint32_t gen;
+		bool reading;
+		bool adopted;
+		bool found;
+		{
+			std::lock_guard<std::mutex> partGuard(hashLatch[part]);
+			found = pinResident(key, file, frameNo, gen, reading, ring != NULL, adopted);
+		}
+		if (found)
+		{
+			if (reading && !waitForRead(frameNo, gen))
+				continue;	// the other thread's read failed, try it ourselves
+			// scans do not make pages look popular
+			if (adopted)
+				replacer->load(frameNo, key);
+			else if (!ring)
+				replacer->access(frameNo, key);
+			page = &bufPool[frameNo];
+			return;
+		}
+
+		// the page is not in the buffer pool: take a frame from the ring or the pool
+		FrameId newFrame;
+		std::uint32_t slot = 0;
+		if (ring)
+		{
+			slot = ring->next;
+			ring->next = (slot + 1) % ring->size;
+		}
+		if (!ring || !reuseRingFrame(*ring, slot, newFrame))
+			allocBuf(newFrame);					//allocate a buffer frame
+		{
+			std::lock_guard<std::mutex> partGuard(hashLatch[part]);
+			found = pinResident(key, file, frameNo, gen, reading, ring != NULL, adopted);
+			if (!found)
+			{
+				hashTable[part]->tryInsert(key, newFrame); // insert the page in the hashtable
+				std::lock_guard<SpinLatch> guard(bufDescTable[newFrame].latch);
+				bufDescTable[newFrame].Set(file, pageNo);
+				linkFrame(newFrame, file);
+				bufDescTable[newFrame].ioInProgress = true;
+				if (ring)
+				{
+					bufDescTable[newFrame].inRing = true;
+					ring->frames[slot] = newFrame;
+					ring->gens[slot] = bufDescTable[newFrame].generation;
+				}
+			}
+		}
+		if (found)
+		{
+			// another thread brought the page in while we were looking for a frame
+			freeBuf(newFrame);
+			if (reading && !waitForRead(frameNo, gen))
+				continue;
+			if (adopted)
+				replacer->load(frameNo, key);
+			else if (!ring)
+				replacer->access(frameNo, key);
+			page = &bufPool[frameNo];
+			return;
+		}
+
+		if (!ring)
+			replacer->load(newFrame, key);
+		bufStats.misses++;
+		fileStats.misses++;
+		try
+		{
+			file->readPage(pageNo, bufPool[newFrame]); //read page from disk straight into the frame
+		}
+		catch (...)
+		{
+			finishRead(newFrame, false);	//hand the frame back, the page does not exist
+			throw;
+		}
+		bufStats.diskreads++;
+		fileStats.diskreads++;
+		finishRead(newFrame, true);
+		page = &bufPool[newFrame];
+		return;
+	}
+}
+
+/**
+* Take back the frame in a slot of the ring for the next page.
+*
+* @param ring    Ring
+* @param slot    Slot of the ring
+* @param frame   Frame reference, the frame is returned reserved via this variable
+* @return True if the frame was taken back
+*/
+bool BufMgr::reuseRingFrame(BufRing &ring, const std::uint32_t slot, FrameId &frame)
+{
+	const FrameId hand = ring.frames[slot];
+	const std::uint32_t ringGen = ring.gens[slot];
+	ring.frames[slot] = BufRing::EMPTY;
+	if (hand == BufRing::EMPTY)
+		return false;
+
+	BufDesc* frameInfo = &bufDescTable[hand];
+	bool claimed = false;
+	bool dirty = false;
+	File* pFile = NULL;
+	{
+		std::lock_guard<SpinLatch> guard(frameInfo->latch);
+		// evicted, disposed or handed over to the policy since the ring read it
+		if (frameInfo->generation != ringGen || !frameInfo->inRing)
+			return false;
+		if (frameInfo->pinCnt == 0)
+		{
+			// claim the frame with a pin so nobody else evicts it
+			frameInfo->Pin();
+			numUnpinned--;
+			claimed = true;
+			dirty = frameInfo->dirty;
+			frameInfo->dirty = false;
+			pFile = frameInfo->file;
+		}
+	}
+	if (!claimed)
+	{
+		// still in use, for example by another scan
+		adoptRingPage(hand, ringGen);
+		return false;
+	}
+
+	if (dirty)
+	{
+		try
+		{
+			pFile->writePage(bufPool[hand]);
+		}
+		catch (...)
+		{
+			{
+				std::lock_guard<SpinLatch> guard(frameInfo->latch);
+				if (frameInfo->generation == ringGen)
+					frameInfo->dirty = true;
+			}
+			releaseBuf(hand, ringGen);
+			adoptRingPage(hand, ringGen);
+			throw;
+		}
+		bufStats.diskwrites++;
+		statsOf(pFile).diskwrites++;
+	}
+	if (evictBuf(hand, ringGen))
+	{
+		frame = hand;
+		return true;
+	}
+	adoptRingPage(hand, ringGen);
+	return false;
+}
+
+/**
+* Hand a page which was read through a ring over to the replacement policy.
+*
+* @param frame   Frame ID of the frame
+* @param gen     Generation of the frame when the ring read the page
+*/
+void BufMgr::adoptRingPage(const FrameId frame, const std::uint32_t gen)
+{
+	BufDesc* frameInfo = &bufDescTable[frame];
+	PageKey key;
+	{
+		std::lock_guard<SpinLatch> guard(frameInfo->latch);
+		if (frameInfo->generation != gen || !frameInfo->inRing)
+			return;
+		frameInfo->inRing = false;
+		key = frameInfo->key;
+	}
+	replacer->load(frame, key);
+}
+
+/**
+* Release all frames of a ring which is being destroyed.  Clean pages which
+* nobody uses go to the free list, the others to the replacement policy.
+*
+* @param ring    Ring
+*/
+void BufMgr::releaseRing(BufRing &ring)
+{
+	for (std::uint32_t slot = 0; slot < ring.size; slot++)
+	{
+		const FrameId hand = ring.frames[slot];
+		if (hand == BufRing::EMPTY)
+			continue;
+		BufDesc* frameInfo = &bufDescTable[hand];
+		bool claimed = false;
+		{
+			std::lock_guard<SpinLatch> guard(frameInfo->latch);
+			if (frameInfo->generation != ring.gens[slot] || !frameInfo->inRing)
+				continue;
+			if (frameInfo->pinCnt == 0 && !frameInfo->dirty)
+			{
+				frameInfo->Pin();
+				numUnpinned--;
+				claimed = true;
+			}
+		}
+		if (claimed && evictBuf(hand, ring.gens[slot]))
+			freeBuf(hand);
+		else
+			adoptRingPage(hand, ring.gens[slot]);
+	}
+}
+
+/**
+* Make one optimistic attempt to run reader on the page with the given key.
+*
+* @param file    File object
+* @param key     Page key
+* @param frameNo Frame which the hash table said holds the page
+* @param reader  Function to run on the page
+* @return True if the frame holds the page and it did not change while reader ran
+*/
+bool BufMgr::tryReadOptimistic(const File *file, const PageKey key, const FrameId frameNo, const std::function<void(const Page&)>& reader)
+{
+	if (frameNo >= numBufs)
+		return false;
+
+	BufDesc* frameInfo = &bufDescTable[frameNo];
+	const std::uint64_t version = frameInfo->version.load(std::memory_order_acquire);
+	// an odd version means the page is pinned and may be changing; the key
+	// only changes while the frame is pinned
+	if ((version & 1) || __atomic_load_n(&frameInfo->key, __ATOMIC_RELAXED) != key)
+		return false;
+
+	std::exception_ptr error;
+	try
+	{
+		reader(bufPool[frameNo]);
+	}
+	catch (...)
+	{
+		error = std::current_exception();
+	}
+
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if (frameInfo->version.load(std::memory_order_relaxed) != version)
+		return false;
+	if (error)
+		std::rethrow_exception(error);
+
+	// the page may have been evicted since; the policy checks the key
+	replacer->access(frameNo, key);
+	BufCounters& fileStats = statsOf(file);
+	bufStats.accesses++;
+	fileStats.accesses++;
+	if (tracer.enabled())
+	{
+		// replayed as a pin which is dropped at once
+		tracer.record(TraceOp::READ, pageKeyFile(key), pageKeyPage(key));
+		tracer.record(TraceOp::UNPIN, pageKeyFile(key), pageKeyPage(key));
+	}
+	if (reuseTracker.enabled())
+		reuseTracker.record(key);
+	return true;
+}
+
+/**
+* Runs reader on the given page, preferably without pinning it.
+*
+* @param file    File object
+* @param PageNo  Page number in the file to be read
+* @param reader  Function to run on the page
+*/
+void BufMgr::readPageOptimistic(File *file, const PageId pageNo, const std::function<void(const Page&)>& reader)
+{
+	const PageKey key = makePageKey(file->id(), pageNo);
+	const std::uint32_t part = partitionOf(key);
+	for (int attempt = 0; attempt < OPTIMISTIC_ATTEMPTS; attempt++)
+	{
+		FrameId frameNo;
+		if (!hashTable[part]->tryLookupOptimistic(key, frameNo))
+			break;	// most likely not resident, no point in trying again
+		if (tryReadOptimistic(file, key, frameNo, reader))
+			return;
+	}
+
+	// conflict or miss: fall back to a pin
+	Page *page;
+	readPage(file, pageNo, page);
+	try
+	{
+		reader(*page);
+	}
+	catch (...)
+	{
+		unPinPage(file, pageNo, false);
+		throw;
+	}
+	unPinPage(file, pageNo, false);
+}
+
+/**
+* Starts reading the given pages of the file into the buffer pool in the background.
+*
+* @param file    File object
+* @param pages   Page numbers in the file
+*/
+void BufMgr::prefetch(File *file, const std::vector<PageId>& pages)
+{
+	for (const PageId pageNo : pages)
+	{
+		if (!prefetchPage(file, pageNo))
+			return;
+	}
+}
+
+/**
+* Starts reading count pages of the file, starting at first, in the background.
+*
+* @param file    File object
+* @param first   Number of the first page
+* @param count   Number of pages
+*/
+void BufMgr::prefetch(File *file, const PageId first, const PageId count)
+{
+	for (PageId pageNo = first; pageNo - first < count; pageNo++)
+	{
+		if (!prefetchPage(file, pageNo))
+			return;
+	}
+}
+
+/**
+* Puts one page into a frame and queues it for the prefetch thread.
+*
+* @param file    File object
+* @param PageNo  Page number in the file
+* @return False if no more pages should be prefetched now
+*/
+bool BufMgr::prefetchPage(File *file, const PageId pageNo)
+{
+	{
+		// pending pages are pinned; leave most of the pool to the readers
+		std::lock_guard<std::mutex> prefetchGuard(prefetchLatch);
+		if (prefetchesPending >= (numBufs / 4 > 0 ? numBufs / 4 : 1))
+			return false;
+	}
+
+	const PageKey key = makePageKey(file->id(), pageNo);
+	const std::uint32_t part = partitionOf(key);
 	FrameId frameNo;
+	{
+		std::lock_guard<std::mutex> partGuard(hashLatch[part]);
+		if (hashTable[part]->tryLookup(key, frameNo))
+			return true;	// resident or on its way already
+	}
+
 	try
 	{
-		hashTable->lookup(file, pageNo, frameNo);
-		page = &bufPool[frameNo];
-		//Increment pin count and set reference bit to 1
-		bufDescTable[frameNo].pinCnt++;
-		bufDescTable[frameNo].refbit = 1;
+		allocBuf(frameNo);
+	}
+	catch (BufferExceededException &)
+	{
+		return false;
+	}
+	bool inserted;
+	std::uint32_t gen = 0;
+	{
+		std::lock_guard<std::mutex> partGuard(hashLatch[part]);
+		inserted = hashTable[part]->tryInsert(key, frameNo);
+		if (inserted)
+		{
+			// readers finding the page wait for the prefetch thread to read it
+			std::lock_guard<SpinLatch> guard(bufDescTable[frameNo].latch);
+			bufDescTable[frameNo].Set(file, pageNo);
+			linkFrame(frameNo, file);
+			bufDescTable[frameNo].ioInProgress = true;
+			gen = bufDescTable[frameNo].generation;
+		}
+	}
+	if (!inserted)
+	{
+		freeBuf(frameNo);	// somebody else read it meanwhile
+		return true;
+	}
+	replacer->load(frameNo, key);
+
+	{
+		std::lock_guard<std::mutex> prefetchGuard(prefetchLatch);
+		PrefetchRequest request = {file, pageNo, frameNo, gen};
+		prefetchQueue.push_back(request);
+		prefetchesPending++;
+		if (!prefetcher.joinable())
+		{
+			prefetchStop = false;
+			prefetcher = std::thread(&BufMgr::runPrefetcher, this);
+		}
 	}
-	catch (const HashNotFoundException &e)
+	prefetchWake.notify_one();
+	return true;
+}
+
+/**
+* Main loop of the prefetch thread: reads the queued pages and unpins them.
+*/
+void BufMgr::runPrefetcher()
+{
+	std::unique_lock<std::mutex> prefetchGuard(prefetchLatch);
+	while (true)
 	{
-		// lookup trows HashNotFoundException since the page is not found in
-		//in the buffer pool
-		allocBuf(frameNo);					//allocate a buffer frame
-		Page page_red = file->readPage(pageNo); //read page from disk to mem
-		bufPool[frameNo] = page_red;
-		page = &bufPool[frameNo];
-		hashTable->insert(file, pageNo, frameNo); // insert the page in the hashtable
-		bufDescTable[frameNo].Set(file, pageNo);
+		prefetchWake.wait(prefetchGuard, [this] { return prefetchStop || !prefetchQueue.empty(); });
+		if (prefetchStop)
+			return;
+		const PrefetchRequest request = prefetchQueue.front();
+		prefetchQueue.pop_front();
+		prefetchGuard.unlock();
+
+		bool ok = true;
+		try
+		{
+			request.file->readPage(request.pageNo, bufPool[request.frame]);
+		}
+		catch (...)
+		{
+			ok = false;		// a hint for a page which does not exist
+		}
+		if (ok)
+		{
+			bufStats.prefetchreads++;
+			statsOf(request.file).prefetchreads++;
+		}
+		finishRead(request.frame, ok);
+		if (ok)
+			releaseBuf(request.frame, request.gen);
+
+		prefetchGuard.lock();
+		prefetchesPending--;
+	}
+}
+
+/**
+* Stops the prefetch thread and gives up the pages it has not read yet.
+*/
+void BufMgr::stopPrefetcher()
+{
+	{
+		std::lock_guard<std::mutex> prefetchGuard(prefetchLatch);
+		prefetchStop = true;
+	}
+	prefetchWake.notify_all();
+	if (prefetcher.joinable())
+		prefetcher.join();
+
+	// readers waiting for these pages read them themselves
+	std::lock_guard<std::mutex> prefetchGuard(prefetchLatch);
+	while (!prefetchQueue.empty())
+	{
+		finishRead(prefetchQueue.front().frame, false);
+		prefetchQueue.pop_front();
+		prefetchesPending--;
 	}
 }
 
@@ -167,26 +1053,311 @@ void BufMgr::readPage(File *file, const PageId pageNo, Page *&page)
 */
 void BufMgr::unPinPage(File *file, const PageId pageNo, const bool dirty)
 {
-	FrameId frameNo;
-	try
-	{ //try to find the page
-		hashTable->lookup(file, pageNo, frameNo);
-		int pin_count = bufDescTable[frameNo].pinCnt;
+	const PageKey key = makePageKey(file->id(), pageNo);
+	const std::uint32_t part = partitionOf(key);
+	{
+		FrameId frameNo;
+		std::lock_guard<std::mutex> partGuard(hashLatch[part]);
+		//Does nothing if page is not found in the Hashtable lookup
+		if (!hashTable[part]->tryLookup(key, frameNo))
+			return;
+
+		BufDesc* frameInfo = &bufDescTable[frameNo];
+		std::lock_guard<SpinLatch> guard(frameInfo->latch);
 		//Throws PAGENOTPINNED if the pin count is already 0
-		if (pin_count == 0)
+		if (frameInfo->pinCnt == 0)
 			throw PageNotPinnedException(file->filename(), pageNo, frameNo);
 		//if dirty == true, sets the dirty bit
 		if (dirty == true)
-			bufDescTable[frameNo].dirty = dirty;
+			frameInfo->dirty = dirty;
 		//Decrements the pinCnt of the frame containing (file, PageNo)
-		bufDescTable[frameNo].pinCnt -= 1;
+		if (frameInfo->Unpin())
+			numUnpinned++;
+	}
+	// recorded once the page is unpinned, outside the latches, as the tracer
+	// may have to wait
+	if (tracer.enabled())
+		tracer.record(dirty ? TraceOp::DIRTY : TraceOp::UNPIN, file->id(), pageNo);
+}
+
+/**
+* Orders the indices of the given keys by hash partition.
+*
+* @param keys    Page keys
+* @param order   Used to return partition << 32 | index for every key, grouped by partition
+*/
+void BufMgr::byPartition(const std::vector<PageKey>& keys, std::vector<std::uint64_t>& order) const
+{
+	order.resize(keys.size());
+	for (std::uint32_t i = 0; i < keys.size(); i++)
+		order[i] = (std::uint64_t)partitionOf(keys[i]) << 32 | i;
+	// small batches hardly share partitions; sorting them costs more than it saves
+	if (keys.size() <= numPartitions)
+		return;
+
+	// counting sort; there are few partitions
+	std::vector<std::uint32_t> next(numPartitions + 1, 0);
+	for (const std::uint64_t entry : order)
+		next[(entry >> 32) + 1]++;
+	for (std::uint32_t p = 1; p < numPartitions; p++)
+		next[p] += next[p - 1];
+	std::vector<std::uint64_t> sorted(keys.size());
+	for (const std::uint64_t entry : order)
+		sorted[next[entry >> 32]++] = entry;
+	order.swap(sorted);
+}
+
+/**
+* Reads a batch of pages of the file and returns the pointers in the same order.
+*
+* @param file    File object
+* @param PageNos Page numbers in the file to be read
+* @param pages   Used to return the pointers to the pages
+*/
+void BufMgr::readPages(File *file, const std::vector<PageId>& pageNos, std::vector<Page*>& pages)
+{
+	// what became of each requested page
+	enum { MISSING, PINNED, WAITING, READING };
+	struct Entry
+	{
+		FrameId frame;
+		std::uint32_t gen;
+		std::uint32_t part;
+		char state;
+		bool adopted;
+	};
+	const std::uint32_t n = pageNos.size();
+	std::vector<PageKey> keys(n);
+	for (std::uint32_t i = 0; i < n; i++)
+		keys[i] = makePageKey(file->id(), pageNos[i]);
+	std::vector<std::uint64_t> order;
+	byPartition(keys, order);
+	std::vector<Entry> entries(n, Entry{0, 0, 0, MISSING, false});
+	BufCounters& fileStats = statsOf(file);
+	std::uint32_t fetched = 0;	// pages read by fetchPage, which counts them itself
+
+	// drops the pins taken so far when the batch fails
+	auto unpinAll = [&]() {
+		// our own reads first, pages listed twice may be waiting for them
+		for (Entry &entry : entries)
+		{
+			if (entry.state == READING)
+			{
+				finishRead(entry.frame, false);
+				entry.state = MISSING;
+			}
+		}
+		for (Entry &entry : entries)
+		{
+			if (entry.state == PINNED || (entry.state == WAITING && waitForRead(entry.frame, entry.gen)))
+				releaseBuf(entry.frame, entry.gen);
+			entry.state = MISSING;
+		}
+	};
+
+	// probe for resident pages, one partition at a time
+	std::uint32_t missing = 0;
+	for (std::uint32_t j = 0; j < n;)
+	{
+		const std::uint32_t part = order[j] >> 32;
+		std::lock_guard<std::mutex> partGuard(hashLatch[part]);
+		for (; j < n && (order[j] >> 32) == part; j++)
+		{
+			const std::uint32_t i = (std::uint32_t)order[j];
+			Entry &entry = entries[i];
+			entry.part = part;
+			bool reading;
+			if (pinResident(keys[i], file, entry.frame, entry.gen, reading, false, entry.adopted))
+				entry.state = reading ? WAITING : PINNED;
+			else
+				missing++;
+		}
 	}
-	catch (const HashNotFoundException &e)
+
+	if (missing > 0)
 	{
-		//Does nothing if page is not found in the Hashtable lookup
+		// reserve frames for the missing pages, then read them in page order
+		std::vector<std::uint32_t> misses;
+		for (std::uint32_t i = 0; i < n; i++)
+		{
+			if (entries[i].state == MISSING)
+				misses.push_back(i);
+		}
+		std::sort(misses.begin(), misses.end(), [&](const std::uint32_t a, const std::uint32_t b) {
+			return pageNos[a] < pageNos[b];
+		});
+		std::vector<PageId> readNos;
+		std::vector<Page*> readInto;
+		try
+		{
+			for (const std::uint32_t i : misses)
+			{
+				Entry &entry = entries[i];
+				FrameId newFrame;
+				allocBuf(newFrame);
+				bool found;
+				{
+					std::lock_guard<std::mutex> partGuard(hashLatch[entry.part]);
+					bool reading;
+					// brought in by another thread, or listed twice in this batch
+					found = pinResident(keys[i], file, entry.frame, entry.gen, reading, false, entry.adopted);
+					if (found)
+						entry.state = reading ? WAITING : PINNED;
+					else
+					{
+						hashTable[entry.part]->tryInsert(keys[i], newFrame);
+						std::lock_guard<SpinLatch> guard(bufDescTable[newFrame].latch);
+						bufDescTable[newFrame].Set(file, pageNos[i]);
+						linkFrame(newFrame, file);
+						bufDescTable[newFrame].ioInProgress = true;
+						entry.frame = newFrame;
+						entry.gen = bufDescTable[newFrame].generation;
+						entry.state = READING;
+					}
+				}
+				if (found)
+					freeBuf(newFrame);
+				else
+				{
+					replacer->load(newFrame, keys[i]);
+					readNos.push_back(pageNos[i]);
+					readInto.push_back(&bufPool[newFrame]);
+				}
+			}
+
+			bufStats.misses += readNos.size();
+			fileStats.misses += readNos.size();
+			file->readPages(readNos, readInto);
+		}
+		catch (...)
+		{
+			unpinAll();
+			throw;
+		}
+		bufStats.diskreads += readNos.size();
+		fileStats.diskreads += readNos.size();
+		for (const std::uint32_t i : misses)
+		{
+			if (entries[i].state == READING)
+			{
+				finishRead(entries[i].frame, true);
+				entries[i].state = PINNED;
+			}
+		}
+	}
+
+	// pages other threads were reading; if their read failed, read them ourselves
+	for (std::uint32_t i = 0; i < n; i++)
+	{
+		Entry &entry = entries[i];
+		if (entry.state != WAITING)
+			continue;
+		if (!waitForRead(entry.frame, entry.gen))
+		{
+			entry.state = MISSING;
+			Page *page;
+			try
+			{
+				fetchPage(file, pageNos[i], page, NULL);
+			}
+			catch (...)
+			{
+				unpinAll();
+				throw;
+			}
+			fetched++;
+			entry.frame = page - bufPool;
+			entry.adopted = false;
+		}
+		entry.state = PINNED;
+	}
+
+	bufStats.accesses += n - fetched;
+	fileStats.accesses += n - fetched;
+	pages.resize(n);
+	for (std::uint32_t i = 0; i < n; i++)
+	{
+		if (entries[i].adopted)
+			replacer->load(entries[i].frame, keys[i]);
+		else
+			replacer->access(entries[i].frame, keys[i]);
+		pages[i] = &bufPool[entries[i].frame];
+	}
+	if (tracer.enabled())
+	{
+		for (std::uint32_t i = 0; i < n; i++)
+			tracer.record(TraceOp::READ, file->id(), pageNos[i]);
+	}
+	if (reuseTracker.enabled())
+	{
+		for (std::uint32_t i = 0; i < n; i++)
+			reuseTracker.record(keys[i]);
 	}
 }
 
+/**
+* Unpins a batch of pages of the file.
+*
+* @param file    File object
+* @param PageNos Page numbers
+* @param dirty   True if the pages need to be marked dirty
+* @throws  PageNotPinnedException If one of the pages is not pinned
+*/
+void BufMgr::unPinPages(File *file, const std::vector<PageId>& pageNos, const bool dirty)
+{
+	std::vector<PageKey> keys(pageNos.size());
+	for (std::uint32_t i = 0; i < keys.size(); i++)
+		keys[i] = makePageKey(file->id(), pageNos[i]);
+
+	bool notPinned = false;
+	PageId notPinnedPage = 0;
+	FrameId notPinnedFrame = 0;
+	std::vector<bool> unpinned(keys.size(), false);
+	std::vector<std::uint64_t> order;
+	byPartition(keys, order);
+	for (std::uint32_t j = 0; j < order.size();)
+	{
+		const std::uint32_t part = order[j] >> 32;
+		std::lock_guard<std::mutex> partGuard(hashLatch[part]);
+		for (; j < order.size() && (order[j] >> 32) == part; j++)
+		{
+			const std::uint32_t i = (std::uint32_t)order[j];
+			FrameId frameNo;
+			if (!hashTable[part]->tryLookup(keys[i], frameNo))
+				continue;
+
+			BufDesc* frameInfo = &bufDescTable[frameNo];
+			std::lock_guard<SpinLatch> guard(frameInfo->latch);
+			if (frameInfo->pinCnt == 0)
+			{
+				if (!notPinned)
+				{
+					notPinned = true;
+					notPinnedPage = pageNos[i];
+					notPinnedFrame = frameNo;
+				}
+				continue;
+			}
+			if (dirty)
+				frameInfo->dirty = true;
+			if (frameInfo->Unpin())
+				numUnpinned++;
+			unpinned[i] = true;
+		}
+	}
+	// only the pages which were unpinned are traced, outside the latches
+	if (tracer.enabled())
+	{
+		for (std::uint32_t i = 0; i < keys.size(); i++)
+		{
+			if (unpinned[i])
+				tracer.record(dirty ? TraceOp::DIRTY : TraceOp::UNPIN, file->id(), pageNos[i]);
+		}
+	}
+	if (notPinned)
+		throw PageNotPinnedException(file->filename(), notPinnedPage, notPinnedFrame);
+}
+
 /**
 * Allocates a new, empty page in the file and returns the Page object.
 * The newly allocated page is also assigned a frame in the buffer pool.
@@ -194,18 +1365,59 @@ void BufMgr::unPinPage(File *file, const PageId pageNo, const bool dirty)
 * @param file    File object
 * @param PageNo  Page number. The number assigned to the page in the file is returned via this reference.
 * @param page    Reference to page pointer. The newly allocated in-memory Page object is returned via this reference.
+* @param deferWrite  True to write the new page only when its frame is written back
 */
-void BufMgr::allocPage(File *file, PageId &pageNo, Page *&page)
+void BufMgr::allocPage(File *file, PageId &pageNo, Page *&page, const bool deferWrite)
 {
     FrameId frameNo;
-    Page p = file->allocatePage(); //store the newly allocated page in p
     allocBuf(frameNo);           //obtain a buffer pool frame
-    bufPool[frameNo] = p;
+    try
+    {
+        //build the new page right in the frame
+        file->allocatePage(bufPool[frameNo], deferWrite);
+    }
+    catch (...)
+    {
+        freeBuf(frameNo);
+        throw;
+    }
+    BufCounters& fileStats = statsOf(file);
+    bufStats.accesses++;
+    bufStats.allocations++;
+    fileStats.accesses++;
+    fileStats.allocations++;
+    if(!deferWrite){
+      //a deferred page does not touch the disk until it is written back
+      bufStats.diskreads++;
+      fileStats.diskreads++;
+    }
     //returns both the page number of the newly allocated page
     page = &bufPool[frameNo];
     pageNo = page->page_number();
-    hashTable->insert(file, pageNo, frameNo); //insert entry in the Hashtable
-    bufDescTable[frameNo].Set(file, pageNo);
+
+    const PageKey key = makePageKey(file->id(), pageNo);
+    const std::uint32_t part = partitionOf(key);
+    bool inserted;
+    {
+        std::lock_guard<std::mutex> partGuard(hashLatch[part]);
+        inserted = hashTable[part]->tryInsert(key, frameNo); //insert entry in the Hashtable
+        if (inserted)
+        {
+            std::lock_guard<SpinLatch> guard(bufDescTable[frameNo].latch);
+            bufDescTable[frameNo].Set(file, pageNo);
+            linkFrame(frameNo, file);
+            bufDescTable[frameNo].dirty = deferWrite;	//a deferred page is only in the frame
+        }
+    }
+    if (inserted)
+    {
+        replacer->load(frameNo, key);
+        if (tracer.enabled())
+            tracer.record(TraceOp::ALLOC, file->id(), pageNo);
+        return;
+    }
+    freeBuf(frameNo);
+    throw HashAlreadyPresentException(file->filename(), pageNo, frameNo);
 }
 
 /**
@@ -217,18 +1429,73 @@ void BufMgr::allocPage(File *file, PageId &pageNo, Page *&page)
 */
 void BufMgr::disposePage(File *file, const PageId pageNo)
 {
-    FrameId frameNo;
-    try
-    {    //makes sure that if the page to be deleted is allocated a frame in the buffer pool, that frame
-        //is freed and correspondingly entry from hash table is also removed
-        hashTable->lookup(file, pageNo, frameNo);
-        hashTable->remove(bufDescTable[frameNo].file, bufDescTable[frameNo].pageNo);
-        bufDescTable[frameNo].Clear();
-    }
-    catch (const HashNotFoundException &e)
+    const PageKey key = makePageKey(file->id(), pageNo);
+    const std::uint32_t part = partitionOf(key);
+    //makes sure that if the page to be deleted is allocated a frame in the buffer pool, that frame
+    //is freed and correspondingly entry from hash table is also removed
+    while (true)
     {
+        FrameId frameNo;
+        std::uint32_t gen;
+        bool reading;
+        bool adopted;
+        {
+            std::lock_guard<std::mutex> partGuard(hashLatch[part]);
+            if (!pinResident(key, file, frameNo, gen, reading, true, adopted))
+                break;
+            if (!reading)
+            {
+                hashTable[part]->tryRemove(key);
+                std::lock_guard<SpinLatch> guard(bufDescTable[frameNo].latch);
+                unlinkFrame(frameNo);
+                bufDescTable[frameNo].Clear();	// drops everybody's pins, including ours
+                bufDescTable[frameNo].Pin();	// reserved for freeBuf, which unpins it
+            }
+        }
+        if (!reading)
+        {
+            freeBuf(frameNo);
+            break;
+        }
+        // let the read finish before taking the page away
+        if (waitForRead(frameNo, gen))
+            releaseBuf(frameNo, gen);
     }
     file->deletePage(pageNo); //delete the page from the file
+    bufStats.disposes++;
+    statsOf(file).disposes++;
+    if (tracer.enabled())
+        tracer.record(TraceOp::DISPOSE, file->id(), pageNo);
+}
+
+/**
+* Reads the given page and returns a handle owning the pin on it.
+*
+* @param file    File object
+* @param PageNo  Page number in the file to be read
+* @return Handle owning the pin on the page
+*/
+PageHandle BufMgr::readPage(File *file, const PageId pageNo)
+{
+	Page *page;
+	readPage(file, pageNo, page);
+	return handleOf(page);
+}
+
+/**
+* Allocates a new page and returns a handle owning the pin on it.
+*
+* @param file    File object
+* @param PageNo  Page number. The number assigned to the page in the file is returned via this reference.
+* @return Handle owning the pin on the page
+*/
+PageHandle BufMgr::allocPage(File *file, PageId &pageNo)
+{
+	Page *page;
+	allocPage(file, pageNo, page);
+	PageHandle handle = handleOf(page);
+	handle.markDirty();
+	return handle;
 }
 
 /**
@@ -242,25 +1509,532 @@ void BufMgr::disposePage(File *file, const PageId pageNo)
 */
 void BufMgr::flushFile(const File *file)
 {
-	 // first check if all pages of this file are unpinned
-      File* pFile = const_cast<File*>(file);
-  for(int i = 0; i < numBufs; i++){
+  bufStats.flushes++;
+  statsOf(file).flushes++;
+  // claim the file's frames, then write the dirty ones back in one batch
+  std::vector<FrameId> claimed;
+  std::vector<std::uint32_t> gens;
+  std::vector<bool> wasDirty;
+  std::vector<const Page*> pages;
+  File* pFile = NULL;
+  std::exception_ptr error;
+  for(const FrameId i : framesOf(file->id())){
+    BufDesc* frame = &bufDescTable[i];
+    std::lock_guard<SpinLatch> guard(frame->latch);
+    if(pageKeyFile(frame->key) != file->id())
+      continue;
+    // first check if all pages of this file are unpinned; the pages
+    // claimed before the one that is not are still flushed
+    if(frame->pinCnt > 0){
+      error = std::make_exception_ptr(PagePinnedException(frame->file->filename(), frame->pageNo(), frame->frameNo));
+      break;
+    }
+    if(!frame->valid){
+      error = std::make_exception_ptr(BadBufferException(frame->frameNo, frame->dirty, frame->valid, false));
+      break;
+    }
+    // claim the frame with a pin while it is written out
+    frame->Pin();
+    numUnpinned--;
+    claimed.push_back(i);
+    gens.push_back(frame->generation);
+    wasDirty.push_back(frame->dirty);
+    if(frame->dirty)
+      pages.push_back(bufPool + i);
+    frame->dirty = false;
+    pFile = frame->file;
+  }
+  if(!pages.empty()){
+    try {
+      pFile->writePages(pages);
+    } catch (...) {
+      // nothing was written; the pages stay dirty in the pool
+      for(std::size_t j = 0; j < claimed.size(); j++)
+        releaseBuf(claimed[j], gens[j], wasDirty[j]);
+      throw;
+    }
+    bufStats.diskwrites += pages.size();
+    statsOf(pFile).diskwrites += pages.size();
+  }
+  for(std::size_t j = 0; j < claimed.size(); j++){
+    if(evictBuf(claimed[j], gens[j]))
+      freeBuf(claimed[j]);
+  }
+  // the pages written before an error has stopped the flush are synced too
+  file->sync(syncPolicy);
+  if(error)
+    std::rethrow_exception(error);
+}
+
+/**
+* Takes all pages of the file out of the buffer pool without writing them back.
+*
+* @param file    File object
+* @throws  PagePinnedException If any page of the file is pinned in the buffer pool
+*/
+void BufMgr::dropFile(const File *file)
+{
+  for(const FrameId i : framesOf(file->id())){
     BufDesc* frame = &bufDescTable[i];
-    if(frame->file == pFile){
+    PageKey key;
+    {
+      std::lock_guard<SpinLatch> guard(frame->latch);
+      if(pageKeyFile(frame->key) != file->id())
+        continue;
+      if(frame->pinCnt > 0)
+        throw PagePinnedException(frame->file->filename(), frame->pageNo(), frame->frameNo);
+      key = frame->key;
+    }
+    const std::uint32_t part = partitionOf(key);
+    {
+      std::lock_guard<std::mutex> partGuard(hashLatch[part]);
+      std::lock_guard<SpinLatch> guard(frame->latch);
+      if(frame->key != key)
+        continue;  // evicted meanwhile
       if(frame->pinCnt > 0)
-        throw PagePinnedException(frame->file->filename(), frame->pageNo, frame->frameNo);
-      if(!frame->valid)
-          throw BadBufferException(frame->frameNo, frame->dirty, frame->valid, frame->refbit);
-      if(frame->dirty){
-        // flush to disk
-        frame->file->writePage(*(bufPool + frame->frameNo));
-        frame->dirty = false;
+        throw PagePinnedException(frame->file->filename(), frame->pageNo(), frame->frameNo);
+      hashTable[part]->tryRemove(key);
+      // claim the frame so nobody evicts it before it is freed
+      frame->Pin();
+      numUnpinned--;
+    }
+    freeBuf(i);
+  }
+}
+
+/**
+* Grows or shrinks the buffer pool while it is in use.
+*
+* @param newFrames   New number of frames
+* @throws  BufferExceededException If newFrames is zero or more than maxBufs
+* @throws  PagePinnedException If a page in the removed frames stays pinned
+*/
+void BufMgr::resize(const std::uint32_t newFrames)
+{
+  if(newFrames == 0 || newFrames > maxBufs)
+    throw BufferExceededException();
+  std::lock_guard<std::mutex> resizeGuard(resizeLatch);
+  const std::uint32_t oldFrames = numBufs;
+  if(newFrames < oldFrames){
+    shrink(newFrames);
+    return;
+  }
+  if(newFrames == oldFrames)
+    return;
+
+  // the added frames were never used or were taken out by shrink(), which
+  // left them pinned; either way nobody else touches them
+  char* start = reinterpret_cast<char*>(bufPool + oldFrames);
+  const std::size_t bytes = (std::size_t)(newFrames - oldFrames) * Page::SIZE;
+  if(arenaFlags & ARENA_LOCKED)
+    mlock(start, bytes);
+  for(FrameId i = oldFrames; i < newFrames; i++){
+    new (&bufPool[i]) Page();
+    std::lock_guard<SpinLatch> guard(bufDescTable[i].latch);
+    bufDescTable[i].Clear();
+  }
+  replacer->resize(newFrames);
+  std::lock_guard<std::mutex> freeGuard(freeLatch);
+  for(FrameId i = newFrames; i > oldFrames; i--)
+    freeList[freeCount++] = i - 1;
+  numUnpinned += newFrames - oldFrames;
+  numBufs = newFrames;
+}
+
+/**
+* Takes the frames from newFrames up out of the buffer pool, writing back
+* their dirty pages.
+*
+* @param newFrames   New number of frames
+* @throws PagePinnedException If a page in the removed frames stays pinned
+*/
+void BufMgr::shrink(const std::uint32_t newFrames)
+{
+  const std::uint32_t oldFrames = numBufs;
+  {
+    // from now on the removed frames are neither handed out nor freed to the
+    // free list, so once unpinned they stay unpinned until collected below
+    std::lock_guard<std::mutex> freeGuard(freeLatch);
+    numBufs = newFrames;
+    std::uint32_t kept = 0;
+    for(std::uint32_t i = 0; i < freeCount; i++)
+      if(freeList[i] < newFrames)
+        freeList[kept++] = freeList[i];
+    freeCount = kept;
+  }
+
+  // collect the frames from the top, so a pinned one leaves a smaller pool
+  FrameId frame = oldFrames;
+  try {
+    std::chrono::steady_clock::time_point waitStart = std::chrono::steady_clock::now();
+    while(frame > newFrames){
+      const FrameId i = frame - 1;
+      BufDesc* frameInfo = &bufDescTable[i];
+      std::uint32_t gen = 0;
+      bool dirty = false;
+      bool pinned;
+      bool valid = false;
+      File* pFile = NULL;
+      {
+        std::lock_guard<SpinLatch> guard(frameInfo->latch);
+        pinned = frameInfo->pinCnt > 0;
+        if(pinned && std::chrono::steady_clock::now() - waitStart > std::chrono::milliseconds(RESIZE_WAIT_MS))
+          throw PagePinnedException(frameInfo->file ? frameInfo->file->filename() : std::string(),
+                                    frameInfo->pageNo(), frameInfo->frameNo);
+        if(!pinned){
+          // claim the frame with a pin, which it keeps while out of the pool;
+          // an unpinned invalid frame is idle, off the free list and unknown
+          // to everybody else
+          frameInfo->Pin();
+          numUnpinned--;
+          valid = frameInfo->valid;
+          gen = frameInfo->generation;
+          dirty = frameInfo->dirty;
+          frameInfo->dirty = false;
+          pFile = frameInfo->file;
+        }
+      }
+      if(pinned){
+        // give short-lived pins, like those of readers and writers in
+        // progress, a moment to go away
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+        continue;
+      }
+      if(!valid){
+        frame--;
+        waitStart = std::chrono::steady_clock::now();
+        continue;
+      }
+      if(dirty){
+        try {
+          pFile->writePage(bufPool[i]);
+        } catch (...) {
+          releaseBuf(i, gen, true);
+          throw;
+        }
+        bufStats.diskwrites++;
+        statsOf(pFile).diskwrites++;
+      }
+      // evictBuf leaves the frame pinned for us; if somebody pinned the page
+      // meanwhile, it dropped our pin and we wait for theirs
+      if(evictBuf(i, gen)){
+        frame--;
+        waitStart = std::chrono::steady_clock::now();
+      }
+    }
+  } catch (...) {
+    // the frames below the one which could not be collected stay in the pool
+    {
+      std::lock_guard<std::mutex> freeGuard(freeLatch);
+      numBufs = frame;
+      for(FrameId i = newFrames; i < frame; i++){
+        std::lock_guard<SpinLatch> guard(bufDescTable[i].latch);
+        if(!bufDescTable[i].valid && bufDescTable[i].pinCnt == 0)
+          freeList[freeCount++] = i;
       }
-      hashTable->remove(file, frame->pageNo);
-      frame->Clear();
     }
+    releaseFrames(frame, oldFrames);
+    throw;
   }
-  
+  releaseFrames(newFrames, oldFrames);
+}
+
+/**
+* Gives the memory of frames which shrink() took out of the pool back to the
+* system.
+*
+* @param first   First frame
+* @param last    One past the last frame
+*/
+void BufMgr::releaseFrames(const FrameId first, const FrameId last)
+{
+  replacer->resize(first);
+  if(first >= last)
+    return;
+  char* start = reinterpret_cast<char*>(bufPool + first);
+  const std::size_t bytes = (std::size_t)(last - first) * Page::SIZE;
+  if(arenaFlags & ARENA_LOCKED)
+    munlock(start, bytes);
+  madvise(start, bytes, MADV_DONTNEED);
+}
+
+/**
+* Adds a frame to the index of the file whose page it now holds.
+*
+* @param frame   Frame ID of the frame
+* @param file    File object
+*/
+void BufMgr::linkFrame(const FrameId frame, const File* file)
+{
+  const PageKey head = makePageKey(file->id(), 0);
+  FileCounters& stats = statsOf(file);
+  std::lock_guard<std::mutex> fileGuard(fileLatch);
+  FrameId first;
+  if(fileHeads->tryLookup(head, first)){
+    filePrev[first] = frame;
+    fileHeads->tryRemove(head);
+  } else {
+    first = maxBufs;
+  }
+  fileHeads->tryInsert(head, frame);
+  fileNext[frame] = first;
+  filePrev[frame] = maxBufs;
+  fileOf[frame] = file->id();
+  fileStatsOf[frame] = &stats;
+  stats.frames++;
+}
+
+/**
+* Removes a frame from the per-file index, if it is in it.
+*
+* @param frame   Frame ID of the frame
+*/
+void BufMgr::unlinkFrame(const FrameId frame)
+{
+  std::lock_guard<std::mutex> fileGuard(fileLatch);
+  const FileId file = fileOf[frame];
+  if(file == File::INVALID_ID)
+    return;
+  // maxBufs ends the lists in both directions
+  const PageKey head = makePageKey(file, 0);
+  if(filePrev[frame] == maxBufs){
+    fileHeads->tryRemove(head);
+    if(fileNext[frame] != maxBufs)
+      fileHeads->tryInsert(head, fileNext[frame]);
+  } else {
+    fileNext[filePrev[frame]] = fileNext[frame];
+  }
+  if(fileNext[frame] != maxBufs)
+    filePrev[fileNext[frame]] = filePrev[frame];
+  fileOf[frame] = File::INVALID_ID;
+  fileStatsOf[frame]->frames--;
+  fileStatsOf[frame] = NULL;
+}
+
+/**
+* Returns the frames currently holding pages of the file.
+*
+* @param file    Identifier of the file
+* @return Frame IDs; frames may change hands once the latch is released
+*/
+std::vector<FrameId> BufMgr::framesOf(const FileId file)
+{
+  std::vector<FrameId> frames;
+  std::lock_guard<std::mutex> fileGuard(fileLatch);
+  FrameId frame;
+  if(!fileHeads->tryLookup(makePageKey(file, 0), frame))
+    return frames;
+  for(; frame != maxBufs; frame = fileNext[frame])
+    frames.push_back(frame);
+  return frames;
+}
+
+/**
+* Writes back dirty unpinned pages which are going to be evicted next.
+*
+* @param target  Number of frames to keep reclaimable without a write
+* @return Number of pages written
+*/
+std::uint32_t BufMgr::cleanAhead(const std::uint32_t target)
+{
+  std::uint32_t clean;
+  {
+    std::lock_guard<std::mutex> freeGuard(freeLatch);
+    clean = freeCount;
+  }
+  std::uint32_t written = 0;
+  const std::uint32_t n = clean < target ? replacer->upcoming(bgFrames, numBufs) : 0;
+  for(std::uint32_t i = 0; i < n && clean < target; i++){
+    const FrameId frameNo = bgFrames[i];
+    BufDesc* frame = &bufDescTable[frameNo];
+    std::uint32_t gen;
+    File* pFile;
+    {
+      std::lock_guard<SpinLatch> guard(frame->latch);
+      // pinned pages are not evicted, so they are not worth writing yet
+      if(!frame->valid || frame->pinCnt > 0)
+        continue;
+      clean++;
+      if(!frame->dirty)
+        continue;
+      // claim the frame with a pin while it is written out
+      frame->Pin();
+      numUnpinned--;
+      gen = frame->generation;
+      frame->dirty = false;
+      pFile = frame->file;
+    }
+    try {
+      pFile->writePage(bufPool[frameNo]);
+      BufCounters& fileStats = statsOf(pFile);
+      bufStats.diskwrites++;
+      bufStats.bgwrites++;
+      fileStats.diskwrites++;
+      fileStats.bgwrites++;
+      written++;
+    } catch (...) {
+      // leave the page dirty; the miss which evicts it reports the error
+      std::lock_guard<SpinLatch> guard(frame->latch);
+      if(frame->generation == gen)
+        frame->dirty = true;
+    }
+    releaseBuf(frameNo, gen);
+  }
+  return written;
+}
+
+/**
+* Main loop of the background writer thread.
+*/
+void BufMgr::runBgWriter()
+{
+  std::unique_lock<std::mutex> bgGuard(bgLatch);
+  while(!bgStop){
+    const std::uint32_t target = bgCleanTarget;
+    bgGuard.unlock();
+    cleanAhead(target);
+    bgGuard.lock();
+    if(!bgStop)
+      bgWake.wait_for(bgGuard, std::chrono::milliseconds(bgIntervalMs));
+  }
+}
+
+/**
+* Starts the background writer thread.
+*
+* @param cleanFrames  Number of frames to keep reclaimable without a write
+* @param intervalMs   Milliseconds between two rounds
+*/
+void BufMgr::startBgWriter(const std::uint32_t cleanFrames, const std::uint32_t intervalMs)
+{
+  stopBgWriter();
+  std::lock_guard<std::mutex> bgGuard(bgLatch);
+  bgStop = false;
+  const std::uint32_t frames = numBufs;
+  bgCleanTarget = cleanFrames < frames ? cleanFrames : frames;
+  bgIntervalMs = intervalMs;
+  bgWriter = std::thread(&BufMgr::runBgWriter, this);
+}
+
+/**
+* Stops the background writer thread.
+*/
+void BufMgr::stopBgWriter()
+{
+  {
+    std::lock_guard<std::mutex> bgGuard(bgLatch);
+    bgStop = true;
+  }
+  bgWake.notify_all();
+  if(bgWriter.joinable())
+    bgWriter.join();
+}
+
+/**
+* Publishes the statistics in a shared memory object.
+*
+* @param name         Name of the shared memory object
+* @param intervalMs   Milliseconds between two updates
+* @throws  std::system_error If the shared memory object cannot be created
+*/
+void BufMgr::exportStats(const std::string& name, const std::uint32_t intervalMs)
+{
+  stopExportStats();
+  const int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+  if(fd < 0)
+    throw std::system_error(errno, std::generic_category(), "shm_open " + name);
+  void* mem = MAP_FAILED;
+  if(ftruncate(fd, sizeof(BufStatsRegion)) == 0)
+    mem = mmap(NULL, sizeof(BufStatsRegion), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  const int error = errno;
+  close(fd);
+  if(mem == MAP_FAILED){
+    shm_unlink(name.c_str());
+    throw std::system_error(error, std::generic_category(), "mmap " + name);
+  }
+
+  std::lock_guard<std::mutex> exportGuard(exportLatch);
+  exportStop = false;
+  exportName = name;
+  exportIntervalMs = intervalMs;
+  exportRegion = new (mem) BufStatsRegion();
+  publishStats();
+  // readers check the magic number, so only set it once the region is filled in
+  exportRegion->magic = BufStatsRegion::MAGIC;
+  statsExporter = std::thread(&BufMgr::runStatsExporter, this);
+}
+
+/**
+* Stops exporting the statistics and removes the shared memory object.
+*/
+void BufMgr::stopExportStats()
+{
+  {
+    std::lock_guard<std::mutex> exportGuard(exportLatch);
+    exportStop = true;
+  }
+  exportWake.notify_all();
+  if(statsExporter.joinable())
+    statsExporter.join();
+  std::lock_guard<std::mutex> exportGuard(exportLatch);
+  if(exportRegion == NULL)
+    return;
+  munmap(exportRegion, sizeof(BufStatsRegion));
+  shm_unlink(exportName.c_str());
+  exportRegion = NULL;
+}
+
+/**
+* Main loop of the statistics export thread.
+*/
+void BufMgr::runStatsExporter()
+{
+  std::unique_lock<std::mutex> exportGuard(exportLatch);
+  while(!exportStop){
+    publishStats();
+    exportWake.wait_for(exportGuard, std::chrono::milliseconds(exportIntervalMs));
+  }
+}
+
+/**
+* Copies the statistics to the exported region, which readers see change as
+* a whole.  Called with exportLatch held.
+*/
+void BufMgr::publishStats()
+{
+  BufStatsRegion* region = exportRegion;
+  region->sequence.fetch_add(1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  region->pid = getpid();
+  region->frames = numBufs;
+  region->updatedMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+  region->totals.copyFrom(bufStats);
+  std::uint32_t n = 0;
+  for(std::uint32_t slot = 0; slot < BufStats::FILE_SLOTS; slot++){
+    const FileId file = bufStats.files[slot].file.load(std::memory_order_acquire);
+    if(file == 0)
+      continue;
+    BufStatsRegion::FileEntry& entry = region->files[n++];
+    entry.file = file;
+    std::strncpy(entry.name, bufStats.nameOf(slot).c_str(), BufStatsRegion::NAME_LEN - 1);
+    entry.name[BufStatsRegion::NAME_LEN - 1] = '\0';
+    entry.counters.copyFrom(bufStats.files[slot]);
+  }
+  // files end up in otherFiles if their slot is beyond the table or still
+  // held by pages of a closed file
+  const BufCounters& others = bufStats.otherFiles;
+  if(n == BufStats::FILE_SLOTS || others.accesses > 0 || others.diskwrites > 0
+      || others.cleanevictions > 0 || others.dirtyevictions > 0){
+    BufStatsRegion::FileEntry& entry = region->files[n++];
+    entry.file = 0;
+    std::strncpy(entry.name, "(other files)", BufStatsRegion::NAME_LEN - 1);
+    entry.counters.copyFrom(bufStats.otherFiles);
+  }
+  region->numFiles = n;
+
+  region->sequence.fetch_add(1, std::memory_order_release);
 }
 
 /**
@@ -284,4 +2058,102 @@ void BufMgr::printSelf(void)
 	std::cout << "Total Number of Valid Frames:" << validFrames << "\n";
 }
 
+/**
+* Class constructor.  The ring starts out empty and takes frames from the
+* pool as the scan reads pages.
+*/
+BufRing::BufRing(BufMgr &mgr, std::uint32_t numFrames)
+	: bufMgr(mgr), next(0)
+{
+	// like any single user, a ring may take at most an eighth of the pool
+	const std::uint32_t maxFrames = mgr.numBufs / 8 > 0 ? mgr.numBufs / 8 : 1;
+	size = numFrames < maxFrames ? numFrames : maxFrames;
+	if (size == 0)
+		size = 1;
+	frames = new FrameId[size];
+	gens = new std::uint32_t[size];
+	for (std::uint32_t i = 0; i < size; i++)
+		frames[i] = EMPTY;
+}
+
+/**
+* Releases the frames of the ring.
+*/
+BufRing::~BufRing()
+{
+	bufMgr.releaseRing(*this);
+	delete[] frames;
+	delete[] gens;
+}
+
+/**
+* Constructor used by BufMgr for a pinned frame.
+*/
+PageHandle::PageHandle(BufMgr *mgr, Page *pinnedPage, FrameId pinnedFrame, std::uint32_t pinnedGen)
+	: bufMgr(mgr), page(pinnedPage), frame(pinnedFrame), gen(pinnedGen), dirty(false)
+{
+}
+
+/**
+* Constructs an empty handle.
+*/
+PageHandle::PageHandle()
+	: bufMgr(NULL), page(NULL), frame(0), gen(0), dirty(false)
+{
+}
+
+/**
+* Takes over the pin of other, which becomes empty.
+*/
+PageHandle::PageHandle(PageHandle &&other)
+	: bufMgr(other.bufMgr), page(other.page), frame(other.frame), gen(other.gen), dirty(other.dirty)
+{
+	other.bufMgr = NULL;
+	other.page = NULL;
+}
+
+/**
+* Drops the current pin, if any, and takes over the pin of other.
+*/
+PageHandle &PageHandle::operator=(PageHandle &&other)
+{
+	if (this != &other)
+	{
+		release();
+		bufMgr = other.bufMgr;
+		page = other.page;
+		frame = other.frame;
+		gen = other.gen;
+		dirty = other.dirty;
+		other.bufMgr = NULL;
+		other.page = NULL;
+	}
+	return *this;
+}
+
+/**
+* Drops the pin, if any.
+*/
+PageHandle::~PageHandle()
+{
+	release();
+}
+
+/**
+* Drops the pin now, straight through the frame.
+*/
+void PageHandle::release()
+{
+	if (bufMgr == NULL)
+		return;
+	// a stale handle releases nothing and so records nothing
+	PageKey key;
+	if (bufMgr->releaseBuf(frame, gen, dirty, &key))
+		bufMgr->tracePage(dirty ? TraceOp::DIRTY : TraceOp::UNPIN, key);
+	bufMgr = NULL;
+	page = NULL;
+	dirty = false;
+}
+
 } // namespace badgerdb
+
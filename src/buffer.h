@@ -7,8 +7,23 @@
 
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
 #include "file.h"
 #include "bufHashTbl.h"
+#include "bufStats.h"
+#include "latch.h"
+#include "pageTrace.h"
+#include "reuseTracker.h"
+#include "replacer.h"
 
 namespace badgerdb {
 
@@ -19,6 +34,10 @@ class BufMgr;
 
 /**
 * @brief Class for maintaining information about buffer pool frames
+*
+* All fields are protected by the frame's latch.  A frame is in the hash table
+* exactly when it is valid; both change together under the latch of the page's
+* hash partition and the frame latch, always taken in that order.
 */
 class BufDesc {
 
@@ -26,14 +45,15 @@ class BufDesc {
 
  private:
 	/**
-   * Pointer to file to which corresponding frame is assigned
+   * Pointer to file to which corresponding frame is assigned.  Used for
+   * writing the page back; any File object open on the same file will do.
 	 */
   File* file;
 
 	/**
-   * Page within file to which corresponding frame is assigned
+   * Key of the page, (file id, page number), to which corresponding frame is assigned
 	 */
-  PageId pageNo;
+  PageKey key;
 
 	/**
    * Frame number of the frame, in the buffer pool, being used
@@ -56,26 +76,95 @@ class BufDesc {
   bool valid;
 
 	/**
-   * Has this buffer frame been reference recently
+   * True while the page is being read into the frame.  Threads which find the
+   * page in the hash table pin it and wait for the read to finish.  Atomic so
+   * waiters can test it without taking the latch.
+	 */
+  std::atomic<bool> ioInProgress;
+
+	/**
+   * Incremented whenever the frame is assigned to or released from a page.
+   * Lets a thread which dropped the latch detect that the frame was reused
+   * (for example disposed while it was writing the page back).
+	 */
+  std::uint32_t generation;
+
+	/**
+   * Odd while the frame is pinned and even while it is not; bumped on every
+   * transition.  Pages only change identity or contents while pinned, so an
+   * optimistic reader which sees the same even version before and after
+   * reading the page has read a consistent copy.  Readable without the latch.
+	 */
+  std::atomic<std::uint64_t> version;
+
+	/**
+   * True if the page was read through a BufRing which will recycle the
+   * frame.  Such pages are not known to the replacement policy.
+	 */
+  bool inRing;
+
+	/**
+   * Latch protecting the fields of this descriptor
 	 */
-  bool refbit;
+  SpinLatch latch;
+
+	/**
+   * Page within file to which corresponding frame is assigned
+	 */
+  PageId pageNo() const
+	{
+		return pageKeyPage(key);
+	}
+
+	/**
+   * Pin the frame once more
+	 *
+	 * @return True if the frame was unpinned before
+	 */
+  bool Pin()
+	{
+		if (pinCnt++ > 0)
+			return false;
+		// make the odd version visible before any write to the page
+		version.fetch_add(1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		return true;
+	}
+
+	/**
+   * Drop one pin of the frame
+	 *
+	 * @return True if the frame is unpinned now
+	 */
+  bool Unpin()
+	{
+		if (--pinCnt > 0)
+			return false;
+		version.fetch_add(1, std::memory_order_release);
+		return true;
+	}
 
 	/**
    * Initialize buffer frame for a new user
 	 */
   void Clear()
 	{
+		if (pinCnt > 0)
+			version.fetch_add(1, std::memory_order_release);
     pinCnt = 0;
 		file = NULL;
-		pageNo = Page::INVALID_NUMBER;
+		key = makePageKey(File::INVALID_ID, Page::INVALID_NUMBER);
     dirty = false;
-    refbit = false;
 		valid = false;
+		inRing = false;
+		ioInProgress = false;
+		generation++;
   };
 
 	/**
 	 * Set values of member variables corresponding to assignment of frame to a page in the file. Called when a frame 
-	 * in buffer pool is allocated to any page in the file through readPage() or allocPage()
+	 * in buffer pool is allocated to any page in the file through readPage() or allocPage(), after allocBuf()
+	 * has pinned the frame once for the caller.
 	 *
 	 * @param filePtr	File object
 	 * @param pageNum	Page number in the file
@@ -83,11 +172,10 @@ class BufDesc {
   void Set(File* filePtr, PageId pageNum)
 	{ 
 		file = filePtr;
-    pageNo = pageNum;
-    pinCnt = 1;
+    key = makePageKey(filePtr->id(), pageNum);
     dirty = false;
     valid = true;
-    refbit = true;
+    generation++;
   }
 
   void Print()
@@ -95,21 +183,21 @@ class BufDesc {
 		if(file)
 		{
 			std::cout << "file:" << file->filename() << " ";
-			std::cout << "pageNo:" << pageNo << " ";
+			std::cout << "pageNo:" << pageNo() << " ";
 		}
 		else
 			std::cout << "file:NULL ";
 
 		std::cout << "valid:" << valid << " ";
 		std::cout << "pinCnt:" << pinCnt << " ";
-		std::cout << "dirty:" << dirty << " ";
-		std::cout << "refbit:" << refbit << "\n";
+		std::cout << "dirty:" << dirty << "\n";
   }
 
 	/**
    * Constructor of BufDesc class 
 	 */
   BufDesc()
+		: pinCnt(0), generation(0), version(0)
 	{
   	Clear();
   }
@@ -117,63 +205,231 @@ class BufDesc {
 
 
 /**
-* @brief Class to maintain statistics of buffer usage 
+* @brief Small private ring of frames for reading large files sequentially
+*
+* A scan which reads its pages through a BufRing recycles the few frames of
+* the ring instead of taking frames from the whole pool, and its pages are
+* not reported to the replacement policy.  The scan therefore neither evicts
+* the working set of other users nor looks like a working set itself.  Pages
+* read through a ring are still shared: other readers find them in the pool,
+* and a page which somebody else asks for is handed over to the replacement
+* policy instead of being recycled.
+*
+* A ring is used by one thread at a time and must not outlive its BufMgr.
+* When it is destroyed, its unused clean pages are released to the free list.
 */
-struct BufStats
+class BufRing
 {
+	friend class BufMgr;
+
+ private:
 	/**
-   * Total number of accesses to buffer pool
+   * Marks an empty slot
 	 */
-  int accesses;
+  static const FrameId EMPTY = ~0u;
 
 	/**
-   * Number of pages read from disk (including allocs)
+   * Buffer manager whose frames the ring uses
 	 */
-  int diskreads;
+  BufMgr &bufMgr;
 
 	/**
-   * Number of pages written back to disk
+   * Number of slots
 	 */
-  int diskwrites;
+  std::uint32_t size;
 
 	/**
-   * Clear all values 
+   * Frame in every slot, and the frame's generation when the ring read a page into it
 	 */
-  void clear()
-  {
-		accesses = diskreads = diskwrites = 0;
-  }
-      
+  FrameId *frames;
+  std::uint32_t *gens;
+
 	/**
-   * Constructor of BufStats class 
+   * Slot the next page read from disk goes into
 	 */
-  BufStats()
-  {
-		clear();
-  }
+  std::uint32_t next;
+
+ public:
+	/**
+   * Default number of frames of a ring, 256 KB of pages
+	 */
+  static const std::uint32_t DEFAULT_FRAMES = 32;
+
+	/**
+   * Constructor of BufRing class
+	 *
+	 * @param mgr   				Buffer manager to read pages from
+	 * @param numFrames   	Number of frames; at most an eighth of the pool is used
+	 */
+  BufRing(BufMgr &mgr, std::uint32_t numFrames = DEFAULT_FRAMES);
+
+	/**
+   * Destructor of BufRing class
+	 */
+  ~BufRing();
+};
+
+/**
+* @brief A pin on a page in the buffer pool which is dropped automatically
+*
+* A PageHandle is returned by the BufMgr functions which pin a page.  It
+* remembers the frame holding the page, so dropping the pin needs no hash
+* table lookup.  The pin is dropped when the handle is destroyed or released,
+* and the page is written back later if markDirty() was called.  Handles can be
+* moved but not copied, so every pin is dropped exactly once.  A handle must
+* not outlive its BufMgr.
+*/
+class PageHandle
+{
+	friend class BufMgr;
+
+ private:
+	/**
+   * Buffer manager holding the pin, NULL for an empty handle
+	 */
+  BufMgr *bufMgr;
+
+	/**
+   * The pinned page, its frame and the frame's generation when it was pinned
+	 */
+  Page *page;
+  FrameId frame;
+  std::uint32_t gen;
+
+	/**
+   * True if the page must be marked dirty when the pin is dropped
+	 */
+  bool dirty;
+
+	/**
+   * Constructor used by BufMgr for a pinned frame
+	 */
+  PageHandle(BufMgr *mgr, Page *pinnedPage, FrameId pinnedFrame, std::uint32_t pinnedGen);
+
+ public:
+	/**
+   * Constructs an empty handle
+	 */
+  PageHandle();
+
+	/**
+   * Takes over the pin of other, which becomes empty
+	 */
+  PageHandle(PageHandle &&other);
+
+	/**
+   * Drops the current pin, if any, and takes over the pin of other
+	 */
+  PageHandle &operator=(PageHandle &&other);
+
+  PageHandle(const PageHandle &) = delete;
+  PageHandle &operator=(const PageHandle &) = delete;
+
+	/**
+   * Drops the pin, if any
+	 */
+  ~PageHandle();
+
+	/**
+   * Returns the pinned page, NULL for an empty handle
+	 */
+  Page *get() const { return page; }
+  Page *operator->() const { return page; }
+  Page &operator*() const { return *page; }
+
+	/**
+   * Returns true unless the handle is empty
+	 */
+  explicit operator bool() const { return bufMgr != NULL; }
+
+	/**
+   * Records that the page has been modified, so it is marked dirty when the pin is dropped
+	 */
+  void markDirty() { dirty = true; }
+
+	/**
+   * Drops the pin now; the handle becomes empty
+	 */
+  void release();
 };
 
 
 /**
 * @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file 
+*
+* BufMgr may be used from several threads at once.  The hash table is split
+* into independently latched partitions and every frame descriptor has its
+* own latch.  Which page to replace is decided by a pluggable Replacer,
+* CLOCK unless another policy is given to the constructor.  Pages are read and
+* written without holding any latch; a thread which asks for a page that is
+* being read by another thread waits for that read instead of issuing its own.
 */
 class BufMgr 
 {
+	friend class BufRing;
+	friend class PageHandle;
+
  private:
 	/**
-   * Current position of clockhand in our buffer pool
+   * Number of condition variables shared by threads waiting for page reads
+	 */
+  static const std::uint32_t IO_STRIPES = 64;
+
+	/**
+   * Number of optimistic attempts readPageOptimistic makes before pinning the page
+	 */
+  static const int OPTIMISTIC_ATTEMPTS = 3;
+
+	/**
+   * Number of threads the destructor writes files back with
+	 */
+  static const std::size_t FLUSH_THREADS = 4;
+
+	/**
+   * How long resize() waits for a page in a removed frame to be unpinned
+	 */
+  static constexpr int RESIZE_WAIT_MS = 100;
+
+	/**
+   * Number of sweeps allocBuf makes without finding a victim before it gives up
+	 */
+  static constexpr std::uint32_t MAX_FAILED_SWEEPS = 64;
+
+	/**
+   * Number of frames in the buffer pool; frames at or above it are not used
+	 */
+  std::atomic<std::uint32_t> numBufs;
+
+	/**
+   * Number of frames the buffer pool can grow to.  Descriptors, the per-file
+   * index and the address space of the arena are reserved for this many.
+	 */
+  std::uint32_t maxBufs;
+
+	/**
+   * Serializes calls of resize()
 	 */
-  FrameId clockHand;
+  std::mutex resizeLatch;
 
 	/**
-   * Number of frames in the buffer pool
+   * Number of partitions of the hash table
 	 */
-  std::uint32_t numBufs;
+  std::uint32_t numPartitions;
 	
 	/**
-   * Hash table mapping (File, page) to frame
+   * Hash table mapping (File, page) to frame, one table per partition
+	 */
+  BufHashTbl **hashTable;
+
+	/**
+   * Latch of every hash table partition
+	 */
+  std::mutex *hashLatch;
+
+	/**
+   * Page replacement policy
 	 */
-  BufHashTbl *hashTable;
+  Replacer *replacer;
 
 	/**
    * Array of BufDesc objects to hold information corresponding to every frame allocation from 'bufPool' (the buffer pool)
@@ -186,28 +442,425 @@ class BufMgr
   BufStats bufStats;
 
 	/**
-   * Advance clock to next frame in the buffer pool
+   * Stack of invalid frames, which can be handed out without running the clock
+	 */
+  FrameId *freeList;
+
+	/**
+   * Number of frames on the free list
+	 */
+  std::uint32_t freeCount;
+
+	/**
+   * Latch protecting the free list
+	 */
+  std::mutex freeLatch;
+
+	/**
+   * Per-file index of the frames holding pages: a doubly linked list of
+   * frames for every file, the file each frame is linked for (INVALID_ID if
+   * none) and the counters its page is counted with (NULL if none), and the
+   * first frame of every file's list keyed by makePageKey(fileId, 0).
+   * Protected by fileLatch, which is taken after any frame latch; the frame
+   * latch is held too when a frame is linked or unlinked.
+	 */
+  FrameId *fileNext;
+  FrameId *filePrev;
+  FileId *fileOf;
+  FileCounters **fileStatsOf;
+  BufHashTbl *fileHeads;
+  std::mutex fileLatch;
+
+	/**
+   * Adds a frame to the index of the file whose page it now holds; the
+   * caller holds the frame latch
+	 */
+  void linkFrame(const FrameId frame, const File* file);
+
+	/**
+   * Removes a frame from the per-file index, if it is in it; the caller
+   * holds the frame latch
+	 */
+  void unlinkFrame(const FrameId frame);
+
+	/**
+   * Returns the frames currently holding pages of the file
+	 */
+  std::vector<FrameId> framesOf(const FileId file);
+
+	/**
+   * Number of frames with a pin count of zero, valid or not
+	 */
+  std::atomic<std::uint32_t> numUnpinned;
+
+	/**
+   * Mutexes and condition variables used to wait for page reads; frame f uses stripe f % IO_STRIPES
+	 */
+  std::mutex ioLatch[IO_STRIPES];
+  std::condition_variable ioDone[IO_STRIPES];
+
+	/**
+   * Background writer thread, joinable while it runs
+	 */
+  std::thread bgWriter;
+
+	/**
+   * Latch and condition variable the background writer sleeps on, and the
+   * settings it runs with; all protected by bgLatch
+	 */
+  std::mutex bgLatch;
+  std::condition_variable bgWake;
+  bool bgStop;
+  std::uint32_t bgCleanTarget;
+  std::uint32_t bgIntervalMs;
+
+	/**
+   * Scratch array of the frames the next victims will be taken from
+	 */
+  FrameId *bgFrames;
+
+	/**
+   * Main loop of the background writer thread
+	 */
+  void runBgWriter();
+
+	/**
+   * Thread copying the statistics to the exported region, joinable while it
+   * runs, and its settings; all protected by exportLatch
+	 */
+  std::thread statsExporter;
+  std::mutex exportLatch;
+  std::condition_variable exportWake;
+  bool exportStop;
+  std::uint32_t exportIntervalMs;
+  std::string exportName;
+  BufStatsRegion* exportRegion;
+
+	/**
+   * Records page accesses while a trace is taken
+	 */
+  PageTracer tracer;
+
+	/**
+   * Records an event for the page with the given key, if a trace is being taken
 	 */
-  void advanceClock();
+  void tracePage(const TraceOp op, const PageKey key)
+  {
+		if (tracer.enabled())
+			tracer.record(op, pageKeyFile(key), pageKeyPage(key));
+  }
 
 	/**
-	 * Allocate a free frame.  
+   * Samples reuse distances of the pages read while a miss ratio curve is
+   * estimated
+	 */
+  ReuseTracker reuseTracker;
+
+	/**
+   * Main loop of the statistics export thread
+	 */
+  void runStatsExporter();
+
+	/**
+   * Copies the statistics to the exported region
+	 */
+  void publishStats();
+
+	/**
+   * How far flushFile() pushes the written pages towards the disk
+	 */
+  std::atomic<SyncPolicy> syncPolicy;
+
+	/**
+   * Memory mapping holding the buffer pool, and its length in bytes
+	 */
+  void* arena;
+  std::size_t arenaBytes;
+
+	/**
+   * ARENA_ flags the arena was mapped with
+	 */
+  std::uint32_t arenaFlags;
+
+	/**
+	 * Maps the arena for the buffer pool, reserving room for maxBufs frames,
+	 * and constructs the first bufs frames in it.
+	 *
+	 * @param bufs   				Number of frames
+	 * @throws std::bad_alloc If the memory cannot be mapped
+	 */
+  void mapArena(std::uint32_t bufs);
+
+	/**
+	 * Takes the frames from newFrames up out of the buffer pool, writing back
+	 * their dirty pages.  Goes down from the highest frame and stops at a
+	 * pinned one.
+	 *
+	 * @param newFrames   	New number of frames
+	 * @throws PagePinnedException If a page in the removed frames is pinned; the
+	 *         pool keeps the frames up to the pinned one
+	 */
+  void shrink(const std::uint32_t newFrames);
+
+	/**
+	 * Gives the memory of frames which shrink() took out of the pool back to
+	 * the system, and tells the replacement policy the new size.
+	 *
+	 * @param first   			First frame, also the new number of frames
+	 * @param last   				One past the last frame
+	 */
+  void releaseFrames(const FrameId first, const FrameId last);
+
+	/**
+   * A page which prefetch() has put into a frame and which is waiting to be read
+	 */
+  struct PrefetchRequest
+  {
+    File* file;
+    PageId pageNo;
+    FrameId frame;
+    std::uint32_t gen;
+  };
+
+	/**
+   * Thread reading prefetched pages, started by the first prefetch()
+	 */
+  std::thread prefetcher;
+
+	/**
+   * Queue of pages to prefetch and the number of them still being read, the
+   * latch protecting both and the condition variable the thread sleeps on
+	 */
+  std::deque<PrefetchRequest> prefetchQueue;
+  std::uint32_t prefetchesPending;
+  bool prefetchStop;
+  std::mutex prefetchLatch;
+  std::condition_variable prefetchWake;
+
+	/**
+   * Main loop of the prefetch thread
+	 */
+  void runPrefetcher();
+
+	/**
+   * Stops the prefetch thread and gives up the pages it has not read yet
+	 */
+  void stopPrefetcher();
+
+	/**
+	 * Orders the indices of the given keys by hash partition, so that a batch
+	 * can take each partition latch once.  Batches no larger than the number
+	 * of partitions are left in their order.
+	 *
+	 * @param keys   	Page keys
+	 * @param order  	Used to return partition << 32 | index for every key, grouped by partition
+	 */
+  void byPartition(const std::vector<PageKey>& keys, std::vector<std::uint64_t>& order) const;
+
+	/**
+	 * Puts one page into a frame and queues it for the prefetch thread.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file
+	 * @return False if no more pages should be prefetched now
+	 */
+  bool prefetchPage(File* file, const PageId PageNo);
+
+	/**
+   * Returns the statistics of the file
+	 */
+  FileCounters& statsOf(const File* file)
+  {
+		return bufStats.ofFile(file->id(), file->slot(), file->filename());
+  }
+
+	/**
+   * Returns the hash table partition holding the page with the given key
+	 */
+  std::uint32_t partitionOf(const PageKey key) const
+  {
+		return (std::uint32_t)(BufHashTbl::mix(key) >> 32) % numPartitions;
+  }
+
+	/**
+	 * Allocate a free frame.  The frame is returned invalid, outside the hash
+	 * table and pinned once on behalf of the caller, so no other thread can
+	 * take it.
 	 *
 	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
 	 * @throws BufferExceededException If no such buffer is found which can be allocated
 	 */
   void allocBuf(FrameId & frame);
 
+	/**
+	 * Clear a frame and put it on the free list.  The frame must not be in the
+	 * hash table and no other thread may hold a pin on it.
+	 *
+	 * @param frame   	Frame ID of the frame to release
+	 */
+  void freeBuf(const FrameId frame);
+
+	/**
+	 * Take the frame's page out of the pool.  The caller holds exactly one pin
+	 * on the frame, taken while its generation was gen, and has written the
+	 * page back if it was dirty.  If nobody else pinned or dirtied the page in
+	 * the meantime it is removed from the hash table and the frame is left
+	 * invalid and pinned for the caller; otherwise the caller's pin is dropped.
+	 *
+	 * @param frame   	Frame ID of the frame
+	 * @param gen   		Generation of the frame when it was pinned
+	 * @return True if the page was removed
+	 */
+  bool evictBuf(const FrameId frame, const std::uint32_t gen);
+
+	/**
+	 * Drop a pin which the caller took while the frame's generation was gen.
+	 * Does nothing if the frame has been released since.
+	 *
+	 * @param frame   	Frame ID of the frame
+	 * @param gen   		Generation of the frame when it was pinned
+	 * @param dirty   	True if the page needs to be marked dirty
+	 * @param key   		If not NULL, the key of the page is returned via this pointer
+	 * @return True if the pin was dropped
+	 */
+  bool releaseBuf(const FrameId frame, const std::uint32_t gen, const bool dirty = false, PageKey* key = NULL);
+
+	/**
+	 * Wraps the pin which readPage() or allocPage() took on page in a handle.
+	 *
+	 * @param page   	Pinned page in the buffer pool
+	 * @return Handle owning the pin
+	 */
+  PageHandle handleOf(Page *page);
+
+	/**
+	 * Finish a read started by readPage: wake up waiting threads and, if the
+	 * read failed, take the page back out of the hash table.
+	 *
+	 * @param frame   	Frame ID of the frame the page was read into
+	 * @param ok   			True if the read succeeded
+	 */
+  void finishRead(const FrameId frame, const bool ok);
+
+	/**
+	 * Wait until a read into the frame, which the caller has pinned while its
+	 * generation was gen, has finished.  If the read failed the caller's pin
+	 * is dropped.
+	 *
+	 * @param frame   	Frame ID of the frame
+	 * @param gen   		Generation of the frame when it was pinned
+	 * @return True if the frame now holds the page
+	 */
+  bool waitForRead(const FrameId frame, const std::uint32_t gen);
+
+	/**
+	 * Pin the frame holding the page with the given key, if there is one.
+	 * The caller must hold the latch of the key's hash partition.
+	 *
+	 * @param key   		Page key
+	 * @param file   		File object used to read the page
+	 * @param frame   	Frame reference, frame ID of the page returned via this variable
+	 * @param gen   		Generation of the frame when it was pinned
+	 * @param reading   Set to true if the page is still being read
+	 * @param ringRead  True if the caller reads through a BufRing
+	 * @param adopted   Set to true if a page read by a ring was handed over to the replacement policy
+	 * @return True if the page is in the buffer pool
+	 */
+  bool pinResident(const PageKey key, File* file, FrameId &frame, std::uint32_t &gen, bool &reading,
+                   const bool ringRead, bool &adopted);
+
+	/**
+	 * Common part of both readPage() variants.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file to be read
+	 * @param page  	Reference to page pointer
+	 * @param ring  	Ring to read the page through, or NULL
+	 */
+  void fetchPage(File* file, const PageId PageNo, Page*& page, BufRing* ring);
+
+	/**
+	 * Take back the frame in a slot of the ring for the next page.  Fails if
+	 * the frame was evicted, disposed or handed over to the replacement policy
+	 * since the ring read its page, or if somebody is using the page.
+	 *
+	 * @param ring   		Ring
+	 * @param slot   		Slot of the ring
+	 * @param frame   	Frame reference, the frame is returned reserved via this variable
+	 * @return True if the frame was taken back
+	 */
+  bool reuseRingFrame(BufRing &ring, const std::uint32_t slot, FrameId &frame);
+
+	/**
+	 * Hand a page which was read through a ring over to the replacement
+	 * policy, unless the frame has been reused or handed over already.
+	 *
+	 * @param frame   	Frame ID of the frame
+	 * @param gen   		Generation of the frame when the ring read the page
+	 */
+  void adoptRingPage(const FrameId frame, const std::uint32_t gen);
+
+	/**
+	 * Hand an unpinned frame of a ring over to the replacement policy, so that
+	 * policies which do not sweep the frames of rings can evict it.
+	 *
+	 * @return True if a frame was handed over
+	 */
+  bool adoptIdleRingFrame();
+
+	/**
+	 * Release all frames of a ring which is being destroyed.
+	 *
+	 * @param ring   		Ring
+	 */
+  void releaseRing(BufRing &ring);
+
+	/**
+	 * Make one optimistic attempt to run reader on the page with the given key
+	 * without pinning it or taking any latch.
+	 *
+	 * @param file   		File object
+	 * @param key   		Page key
+	 * @param frameNo   Frame which the hash table said holds the page
+	 * @param reader   	Function to run on the page
+	 * @return True if the frame holds the page and it did not change while reader ran
+	 */
+  bool tryReadOptimistic(const File* file, const PageKey key, const FrameId frameNo, const std::function<void(const Page&)>& reader);
+
  public:
 	/**
-   * Actual buffer pool from which frames are allocated
+   * Default number of hash table partitions
+	 */
+  static const std::uint32_t DEFAULT_PARTITIONS = 16;
+
+	/**
+   * Arena flag: ask for transparent huge pages to back the buffer pool
+	 */
+  static const std::uint32_t ARENA_HUGE_PAGES = 1;
+
+	/**
+   * Arena flag: lock the buffer pool in memory, if the process may
+	 */
+  static const std::uint32_t ARENA_LOCKED = 2;
+
+	/**
+   * Actual buffer pool from which frames are allocated.  The frames are one
+   * contiguous arena aligned to the page size, frame i at byte i * Page::SIZE.
 	 */
   Page* bufPool;
 
 	/**
    * Constructor of BufMgr class
+	 *
+	 * @param bufs   				Number of frames in the buffer pool
+	 * @param partitions   	Number of independently latched hash table partitions
+	 * @param policy   			Page replacement policy
+	 * @param arenaFlags   	ARENA_ flags for the memory of the buffer pool
+	 * @param maxBufs   		Number of frames resize() may grow the pool to; bufs if smaller
 	 */
-  BufMgr(std::uint32_t bufs);
+  BufMgr(std::uint32_t bufs, std::uint32_t partitions = DEFAULT_PARTITIONS,
+         ReplacementPolicy policy = ReplacementPolicy::CLOCK,
+         std::uint32_t arenaFlags = ARENA_HUGE_PAGES, std::uint32_t maxBufs = 0);
 	
 	/**
    * Destructor of BufMgr class
@@ -225,6 +878,66 @@ class BufMgr
 	 */
   void readPage(File* file, const PageId PageNo, Page*& page);
 
+	/**
+	 * Reads the given page like readPage(), but if it has to be read from disk
+	 * it goes into a frame of the given ring.  Pages read this way do not
+	 * displace the rest of the pool.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file to be read
+	 * @param page  	Reference to page pointer. Used to fetch the Page object in which requested page from file is read in.
+	 * @param ring  	Ring of frames the scan is confined to
+	 */
+  void readPage(File* file, const PageId PageNo, Page*& page, BufRing &ring);
+
+	/**
+	 * Runs reader on the given page, preferably without pinning it.  If the page
+	 * is resident, reader is run directly on its frame without taking any latch,
+	 * and the frame's version is checked afterwards; if the page was pinned,
+	 * modified or evicted in the meantime the attempt is repeated.  After a few
+	 * failed attempts, or if the page is not resident, the page is pinned with
+	 * readPage() and reader is run on the pinned page.
+	 *
+	 * reader may therefore run several times, and all but the last run may see
+	 * an inconsistent page.  It must only read the page, through accessors which
+	 * check their bounds (such as Page::getRecord), and must only publish its
+	 * results once readPageOptimistic returns.  Exceptions thrown by reader on an
+	 * inconsistent page are ignored; exceptions thrown on a consistent page are
+	 * passed on.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file to be read
+	 * @param reader  Function to run on the page
+	 */
+  void readPageOptimistic(File* file, const PageId PageNo, const std::function<void(const Page&)>& reader);
+
+	/**
+	 * Starts reading the given pages of the file into the buffer pool in the
+	 * background, and returns without waiting for them.  The pages are entered
+	 * in the pool at once, so a readPage() for one of them waits for the
+	 * pending read instead of reading the page again.  Once read, the pages
+	 * stay in the pool unpinned until they are evicted.
+	 *
+	 * Prefetching is a hint: pages which are resident already or do not exist
+	 * are skipped, and no more pages are queued while a quarter of the pool is
+	 * waiting to be read or while all frames are pinned.  The File object must
+	 * stay open until the pages have been read.
+	 *
+	 * @param file   	File object
+	 * @param pages  	Page numbers in the file
+	 */
+  void prefetch(File* file, const std::vector<PageId>& pages);
+
+	/**
+	 * Starts reading count pages of the file, starting at first, in the
+	 * background, like prefetch(file, pages).
+	 *
+	 * @param file   	File object
+	 * @param first  	Number of the first page
+	 * @param count  	Number of pages
+	 */
+  void prefetch(File* file, const PageId first, const PageId count);
+
 	/**
 	 * Unpin a page from memory since it is no longer required for it to remain in memory.
 	 *
@@ -235,27 +948,153 @@ class BufMgr
 	 */
   void unPinPage(File* file, const PageId PageNo, const bool dirty);
 
+	/**
+	 * Reads a batch of pages of the file, like calling readPage() for each of
+	 * them, and returns the pointers in the same order.  The hash table is
+	 * probed once per batch, a partition at a time, and the pages which are
+	 * missing are read in order of their page numbers under one file latch.  A page
+	 * listed twice is pinned twice.
+	 *
+	 * Either all pages are pinned or, if one of them cannot be read or there
+	 * are not enough frames for the batch, none of them is and the exception is
+	 * passed on.
+	 *
+	 * @param file   	File object
+	 * @param PageNos Page numbers in the file to be read
+	 * @param pages  	Used to return the pointers to the pages, one per page number
+	 */
+  void readPages(File* file, const std::vector<PageId>& PageNos, std::vector<Page*>& pages);
+
+	/**
+	 * Unpins a batch of pages of the file, like calling unPinPage() for each of
+	 * them, taking each hash partition latch once.
+	 *
+	 * @param file   	File object
+	 * @param PageNos Page numbers
+	 * @param dirty		True if the pages need to be marked dirty
+   * @throws  PageNotPinnedException If one of the pages is not pinned; the others are still unpinned
+	 */
+  void unPinPages(File* file, const std::vector<PageId>& PageNos, const bool dirty);
+
 	/**
 	 * Allocates a new, empty page in the file and returns the Page object.
 	 * The newly allocated page is also assigned a frame in the buffer pool.
 	 *
+	 * With deferWrite set, the new page is not written to the file right away:
+	 * it only exists in its frame, marked dirty, and first reaches the disk
+	 * when the frame is written back.  This halves the writes of bulk inserts,
+	 * but the page is lost if the buffer manager is not flushed or destroyed.
+	 *
 	 * @param file   	File object
 	 * @param PageNo  Page number. The number assigned to the page in the file is returned via this reference.
 	 * @param page  	Reference to page pointer. The newly allocated in-memory Page object is returned via this reference.
+	 * @param deferWrite	True to write the new page only when its frame is written back
 	 */
-  void allocPage(File* file, PageId &PageNo, Page*& page); 
+  void allocPage(File* file, PageId &PageNo, Page*& page, const bool deferWrite = false); 
 
 	/**
-	 * Writes out all dirty pages of the file to disk.
+	 * Reads the given page like readPage(file, PageNo, page), but returns a
+	 * handle which unpins the page when it goes out of scope.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file to be read
+	 * @return Handle owning the pin on the page
+	 */
+  PageHandle readPage(File* file, const PageId PageNo);
+
+	/**
+	 * Allocates a new page like allocPage(file, PageNo, page), but returns a
+	 * handle which unpins the page when it goes out of scope.  The page is
+	 * new, so the handle marks it dirty.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number. The number assigned to the page in the file is returned via this reference.
+	 * @return Handle owning the pin on the page
+	 */
+  PageHandle allocPage(File* file, PageId &PageNo);
+
+	/**
+	 * Writes out all dirty pages of the file to disk, in file order and with
+	 * adjacent pages coalesced, and syncs the file as the sync policy says.
 	 * All the frames assigned to the file need to be unpinned from buffer pool before this function can be successfully called.
 	 * Otherwise Error returned.
 	 *
 	 * @param file   	File object
    * @throws  PagePinnedException If any page of the file is pinned in the buffer pool 
    * @throws BadBufferException If any frame allocated to the file is found to be invalid
+   * @throws  std::system_error If the file cannot be synced; the pages were written
 	 */
   void flushFile(const File* file);
 
+	/**
+	 * Takes all pages of the file out of the buffer pool without writing them
+	 * back, for files which are being closed for good or removed.  Changes to
+	 * dirty pages are lost.  Like flushFile(), only touches the frames of the
+	 * file.  The file's counters stay in the statistics until another file
+	 * takes over its slot.
+	 *
+	 * @param file   	File object
+   * @throws  PagePinnedException If any page of the file is pinned in the buffer pool; the
+   *          pages checked before it have been dropped
+	 */
+  void dropFile(const File* file);
+
+	/**
+	 * Grows or shrinks the buffer pool while it is in use.  Frames never move,
+	 * so pointers to pinned pages stay valid.  Growing adds free frames, up
+	 * to the maxBufs given to the constructor.  Shrinking evicts the pages
+	 * of the removed frames, writing back dirty ones, and gives their memory
+	 * back to the system.
+	 *
+	 * @param newFrames   	New number of frames, at least one
+	 * @throws  BufferExceededException If newFrames is zero or more than maxBufs
+	 * @throws  PagePinnedException If a page in the removed frames is pinned; the
+	 *          pool is then only shrunk down to just above its frame
+	 */
+  void resize(const std::uint32_t newFrames);
+
+	/**
+	 * Returns the number of frames in the buffer pool.
+	 */
+  std::uint32_t size() const
+	{
+		return numBufs;
+	}
+
+	/**
+	 * Sets how far flushFile() and the destructor push the pages they write
+	 * towards the disk: see File::sync().  Other writes are buffered until then.
+	 *
+	 * @param policy 	Sync policy, SyncPolicy::FLUSH by default
+	 */
+  void setSyncPolicy(const SyncPolicy policy) { syncPolicy = policy; }
+
+	/**
+	 * Writes back dirty unpinned pages which the replacement policy is going to
+	 * evict next, until the free frames and the clean frames at the head of
+	 * the eviction order add up to target.  Misses then find clean victims and
+	 * do not have to write.  Write errors are left to the foreground path.
+	 *
+	 * @param target   	Number of frames to keep reclaimable without a write
+	 * @return Number of pages written
+	 */
+  std::uint32_t cleanAhead(const std::uint32_t target);
+
+	/**
+	 * Starts a background thread which calls cleanAhead(cleanFrames) every
+	 * intervalMs milliseconds, and as soon as a miss had to write back its
+	 * victim.  Restarts the thread with the new settings if it is running.
+	 *
+	 * @param cleanFrames   Number of frames to keep reclaimable without a write
+	 * @param intervalMs   	Milliseconds between two rounds
+	 */
+  void startBgWriter(const std::uint32_t cleanFrames, const std::uint32_t intervalMs = 100);
+
+	/**
+	 * Stops the background writer thread, if it runs, and waits for it.
+	 */
+  void stopBgWriter();
+
 	/**
 	 * Delete page from file and also from buffer pool if present.
 	 * Since the page is entirely deleted from file, its unnecessary to see if the page is dirty.
@@ -278,6 +1117,15 @@ class BufMgr
 		return bufStats;
   }
 
+	/**
+   * Get buffer pool usage statistics of the file; otherFiles of getBufStats()
+   * if the file is not counted separately
+	 */
+  BufCounters & getFileStats(const File* file)
+  {
+		return statsOf(file);
+  }
+
 	/**
    * Clear buffer pool usage statistics
 	 */
@@ -285,6 +1133,71 @@ class BufMgr
   {
 		bufStats.clear();
   }
+
+	/**
+   * Publishes the statistics, the pool's and those of each file, in a POSIX
+   * shared memory object of the given name, laid out as a BufStatsRegion and
+   * refreshed every intervalMs milliseconds by a background thread, so that
+   * badgerdb_stat can watch a running process.  Stops any earlier export.
+	 *
+	 * @param name   				Name of the shared memory object, such as "/badgerdb"
+	 * @param intervalMs   	Milliseconds between two updates
+   * @throws  std::system_error If the shared memory object cannot be created
+	 */
+  void exportStats(const std::string& name, const std::uint32_t intervalMs = 1000);
+
+	/**
+   * Stops exporting the statistics and removes the shared memory object.
+	 */
+  void stopExportStats();
+
+	/**
+   * Starts recording every page access (reads, allocations, unpins and
+   * disposes) into a compact binary trace file, which badgerdb_sim replays
+   * against other pool sizes and replacement policies.  Recording costs an
+   * atomic add and an 8 byte store per event; the file is written by a
+   * background thread.  Restarts the trace if one is being taken.
+	 *
+	 * @param path   	Name of the trace file, which is truncated
+   * @throws  std::system_error If the file cannot be created
+	 */
+  void startTrace(const std::string& path) { tracer.start(path); }
+
+	/**
+   * Stops recording page accesses and completes the trace file.
+	 */
+  void stopTrace() { tracer.stop(); }
+
+	/**
+   * Starts estimating the miss ratio curve of the pages read, that is the
+   * fraction of reads which would miss at other pool sizes, from the reuse
+   * distances of a hashed sample of the pages (SHARDS).  Reads of pages out of
+   * the sample cost a hash; sampled reads take a latch.  Restarts the
+   * estimate if one is running.
+	 *
+	 * @param sampleRate   	Fraction of the pages sampled; 0.01 keeps the error to
+	 *                      a few percent once some thousand pages were sampled
+	 * @param maxFrames   	Largest pool size estimated; four times the current
+	 *                      size if zero
+	 */
+  void startMissRatioCurve(const double sampleRate = 0.01, const std::uint32_t maxFrames = 0)
+  {
+		reuseTracker.start(sampleRate, maxFrames > 0 ? maxFrames : 4 * numBufs.load(), bufStats.reads());
+  }
+
+	/**
+   * Stops estimating the miss ratio curve and frees the sampled state; the
+   * curve estimated so far remains available.
+	 */
+  void stopMissRatioCurve() { reuseTracker.stop(bufStats.reads()); }
+
+	/**
+   * Returns the estimated miss ratio at evenly spaced pool sizes up to the
+   * maxFrames given to startMissRatioCurve(), in order of size.  The
+   * estimate assumes LRU replacement, which the other policies approach or
+   * beat; the hit ratio at a size is one minus its miss ratio.
+	 */
+  std::vector<MissRatioPoint> missRatioCurve() const { return reuseTracker.curve(bufStats.reads()); }
 };
 
 }
@@ -11,8 +11,17 @@
 #include <iostream>
 #include <memory>
 #include <string>
+#include <cstddef>
 #include <cstdio>
 #include <cassert>
+#include <cerrno>
+#include <algorithm>
+#include <climits>
+#include <system_error>
+#include <vector>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
 
 #include "exceptions/file_exists_exception.h"
 #include "exceptions/file_not_found_exception.h"
@@ -25,6 +34,17 @@ namespace badgerdb {
 
 File::StreamMap File::open_streams_;
 File::CountMap File::open_counts_;
+File::DescriptorMap File::open_fds_;
+File::IdMap File::open_ids_;
+FileId File::next_id_ = File::INVALID_ID + 1;
+File::SlotMap File::open_slots_;
+File::FreeSlotMap File::free_slots_;
+std::uint32_t File::next_slot_ = 0;
+File::LatchMap File::open_latches_;
+File::UnwrittenMap File::open_unwritten_;
+File::LinksMap File::open_links_;
+File::WriteHook File::write_hook_ = NULL;
+std::mutex File::registry_latch_;
 
 File File::create(const std::string& filename) {
   return File(filename, true /* create_new */);
@@ -48,6 +68,7 @@ bool File::isOpen(const std::string& filename) {
   if (!exists(filename)) {
     return false;
   }
+  std::lock_guard<std::mutex> registry_guard(registry_latch_);
   return open_counts_.find(filename) != open_counts_.end();
 }
 
@@ -63,8 +84,15 @@ bool File::exists(const std::string& filename) {
 }
 
 File::File(const File& other)
-  : filename_(other.filename_),
-    stream_(open_streams_[filename_]) {
+  : filename_(other.filename_) {
+  std::lock_guard<std::mutex> registry_guard(registry_latch_);
+  stream_ = open_streams_[filename_];
+  fd_ = open_fds_[filename_];
+  latch_ = open_latches_[filename_];
+  unwritten_ = open_unwritten_[filename_];
+  links_ = open_links_[filename_];
+  id_ = open_ids_[filename_];
+  slot_ = open_slots_[filename_];
   ++open_counts_[filename_];
 }
 
@@ -82,11 +110,17 @@ File::~File() {
 }
 
 Page File::allocatePage() {
-  FileHeader header = readHeader();
   Page new_page;
+  allocatePage(new_page);
+  return new_page;
+}
+
+void File::allocatePage(Page& new_page, const bool defer_write) {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  FileHeader header = readHeader();
   Page existing_page;
   if (header.num_free_pages > 0) {
-    new_page = readPage(header.first_free_page, true /* allow_free */);
+    readPage(header.first_free_page, true /* allow_free */, new_page);
     new_page.set_page_number(header.first_free_page);
     header.first_free_page = new_page.next_page_number();
     --header.num_free_pages;
@@ -118,6 +152,7 @@ Page File::allocatePage() {
     assert((header.num_free_pages == 0) ==
            (header.first_free_page == Page::INVALID_NUMBER));
   } else {
+    new_page.initialize();
     new_page.set_page_number(header.num_pages);
     if (header.first_used_page == Page::INVALID_NUMBER) {
       header.first_used_page = new_page.page_number();
@@ -135,18 +170,22 @@ Page File::allocatePage() {
     }
     ++header.num_pages;
   }
-  writePage(new_page.page_number(), new_page);
+  recordLink(new_page.page_number(), new_page);
+  if (defer_write) {
+    (*unwritten_)[new_page.page_number()] = new_page.header_;
+  } else {
+    writePage(new_page.page_number(), new_page);
+  }
   if (existing_page.page_number() != Page::INVALID_NUMBER) {
     // If we updated an existing page by inserting the new page into the
     // used list, we need to write it out.
-    writePage(existing_page.page_number(), existing_page);
+    writeLinks(existing_page);
   }
   writeHeader(header);
-
-  return new_page;
 }
 
 Page File::readPage(const PageId page_number) const {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
   FileHeader header = readHeader();
   if (page_number >= header.num_pages) {
     throw InvalidPageException(page_number, filename_);
@@ -154,34 +193,146 @@ Page File::readPage(const PageId page_number) const {
   return readPage(page_number, false /* allow_free */);
 }
 
+void File::readPage(const PageId page_number, Page& page) const {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  FileHeader header = readHeader();
+  if (page_number >= header.num_pages) {
+    throw InvalidPageException(page_number, filename_);
+  }
+  readPage(page_number, false /* allow_free */, page);
+}
+
+void File::readPages(const std::vector<PageId>& page_numbers,
+                     const std::vector<Page*>& pages) const {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  FileHeader header = readHeader();
+  for (std::size_t i = 0; i < page_numbers.size(); ++i) {
+    if (page_numbers[i] >= header.num_pages) {
+      throw InvalidPageException(page_numbers[i], filename_);
+    }
+    readPage(page_numbers[i], false /* allow_free */, *pages[i]);
+  }
+}
+
 Page File::readPage(const PageId page_number, const bool allow_free) const {
   Page page;
+  readPage(page_number, allow_free, page);
+  return page;
+}
+
+void File::readPage(const PageId page_number, const bool allow_free,
+                    Page& page) const {
+  // the header is followed by the data in memory as on disk, so one read
+  // fills both; reads of a whole page bypass the stream's buffer
+  static_assert(offsetof(Page, data_) == sizeof(PageHeader),
+                "Page data must follow the header.");
+  PageHeaderMap::const_iterator unwritten = unwritten_->find(page_number);
+  if (unwritten != unwritten_->end()) {
+    // allocated, but its contents only exist in the caller's memory
+    page.initialize();
+    page.header_ = unwritten->second;
+    return;
+  }
   stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&page.header_), sizeof(page.header_));
-  stream_->read(reinterpret_cast<char*>(&page.data_[0]), Page::DATA_SIZE);
+  stream_->read(reinterpret_cast<char*>(&page), Page::SIZE);
+  if (stream_->gcount() != static_cast<std::streamsize>(Page::SIZE)) {
+    // a deferred page that was never written reads as a free page
+    stream_->clear();
+    page.initialize();
+  }
   if (!allow_free && !page.isUsed()) {
     throw InvalidPageException(page_number, filename_);
   }
-
-  return page;
 }
 
 void File::writePage(const Page& new_page) {
-  PageHeader header = readPageHeader(new_page.page_number());
-  if (header.current_page_number == Page::INVALID_NUMBER) {
-    // Page has been deleted since it was read.
-    throw InvalidPageException(new_page.page_number(), filename_);
-  }
-  // Page on disk may have had its next page pointer updated since it was read;
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  // The page's next page pointer may have been updated since it was read;
   // we don't modify that, but we do keep all the other modifications to the
-  // page header.
-  const PageId next_page_number = header.next_page_number;
-  header = new_page.header_;
-  header.next_page_number = next_page_number;
+  // page header.  Every such update since the file was opened is in links_,
+  // so the old header need not be read back from disk.
+  PageHeader header = new_page.header_;
+  PageLinkMap::iterator link = links_->find(new_page.page_number());
+  if (link != links_->end()) {
+    if (!link->second.used) {
+      // Page has been deleted since it was read.
+      throw InvalidPageException(new_page.page_number(), filename_);
+    }
+    header.next_page_number = link->second.next_page_number;
+  }
   writePage(new_page.page_number(), header, new_page);
+  if (link != links_->end() &&
+      new_page.next_page_number() == link->second.next_page_number) {
+    // the copy written was read after the change, so the disk and the
+    // writer agree and the link need not be kept
+    links_->erase(link);
+  }
+}
+
+void File::writePages(const std::vector<const Page*>& pages) {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  std::vector<const Page*> sorted(pages);
+  std::sort(sorted.begin(), sorted.end(),
+            [](const Page* a, const Page* b) {
+              return a->page_number() < b->page_number();
+            });
+  // the headers as writePage() would write them, checked before any write
+  std::vector<PageHeader> headers(sorted.size());
+  for (std::size_t i = 0; i < sorted.size(); ++i) {
+    headers[i] = sorted[i]->header_;
+    PageLinkMap::const_iterator link = links_->find(sorted[i]->page_number());
+    if (link != links_->end()) {
+      if (!link->second.used) {
+        throw InvalidPageException(sorted[i]->page_number(), filename_);
+      }
+      headers[i].next_page_number = link->second.next_page_number;
+    }
+  }
+
+  // the stream hides its descriptor, so the pages go through the file's own;
+  // the stream's pending writes go first to keep the order of the writes
+  stream_->flush();
+  std::size_t first = 0;
+  while (first < sorted.size()) {
+    // a run of adjacent pages, as long as one call takes
+    std::size_t last = first + 1;
+    while (last < sorted.size() && last - first < IOV_MAX / 2 &&
+           sorted[last]->page_number() == sorted[last - 1]->page_number() + 1) {
+      ++last;
+    }
+    std::vector<struct iovec> iov(2 * (last - first));
+    for (std::size_t i = first; i < last; ++i) {
+      iov[2 * (i - first)].iov_base = &headers[i];
+      iov[2 * (i - first)].iov_len = sizeof(PageHeader);
+      iov[2 * (i - first) + 1].iov_base = const_cast<char*>(sorted[i]->data_);
+      iov[2 * (i - first) + 1].iov_len = Page::DATA_SIZE;
+    }
+    const ssize_t bytes = static_cast<ssize_t>((last - first) * Page::SIZE);
+    if (fd_ < 0 ||
+        (write_hook_ != NULL &&
+         !write_hook_(sorted[first]->page_number(), last - first)) ||
+        ::pwritev(fd_, iov.data(), static_cast<int>(iov.size()),
+                  pagePosition(sorted[first]->page_number())) != bytes) {
+      // retry what may not have been written through the stream
+      for (std::size_t i = first; i < last; ++i) {
+        writePage(sorted[i]->page_number(), headers[i], *sorted[i]);
+      }
+    }
+    for (std::size_t i = first; i < last; ++i) {
+      unwritten_->erase(sorted[i]->page_number());
+      // as in writePage(), links the written copies agree with are dropped
+      PageLinkMap::iterator link = links_->find(sorted[i]->page_number());
+      if (link != links_->end() &&
+          sorted[i]->next_page_number() == link->second.next_page_number) {
+        links_->erase(link);
+      }
+    }
+    first = last;
+  }
 }
 
 void File::deletePage(const PageId page_number) {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
   FileHeader header = readHeader();
   Page existing_page = readPage(page_number);
   Page previous_page;
@@ -205,13 +356,41 @@ void File::deletePage(const PageId page_number) {
   header.first_free_page = page_number;
   ++header.num_free_pages;
   if (previous_page.isUsed()) {
-    writePage(previous_page.page_number(), previous_page);
+    writeLinks(previous_page);
   }
+  recordLink(page_number, existing_page);
   writePage(page_number, existing_page);
   writeHeader(header);
 }
 
+void File::sync(const SyncPolicy policy) const {
+  if (policy == SyncPolicy::NONE) {
+    return;
+  }
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  errno = 0;
+  if (stream_->flush().bad()) {
+    const int error = errno != 0 ? errno : EIO;
+    stream_->clear();
+    throw std::system_error(error, std::generic_category(),
+                            "cannot flush " + filename_);
+  }
+  if (policy == SyncPolicy::FDATASYNC) {
+    // the stream hides its descriptor, but syncing any descriptor of the
+    // file writes back the file's data
+    if (fd_ < 0) {
+      throw std::system_error(EBADF, std::generic_category(),
+                              "cannot sync " + filename_);
+    }
+    if (::fdatasync(fd_) != 0) {
+      throw std::system_error(errno, std::generic_category(),
+                              "cannot sync " + filename_);
+    }
+  }
+}
+
 FileIterator File::begin() {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
   const FileHeader& header = readHeader();
   return FileIterator(this, header.first_used_page);
 }
@@ -220,7 +399,8 @@ FileIterator File::end() {
   return FileIterator(this, Page::INVALID_NUMBER);
 }
 
-File::File(const std::string& name, const bool create_new) : filename_(name) {
+File::File(const std::string& name, const bool create_new)
+  : filename_(name), fd_(-1), id_(INVALID_ID), slot_(0) {
   openIfNeeded(create_new);
 
   if (create_new) {
@@ -228,13 +408,21 @@ File::File(const std::string& name, const bool create_new) : filename_(name) {
     FileHeader header = {1 /* num_pages */, 0 /* first_used_page */,
                          0 /* num_free_pages */, 0 /* first_free_page */};
     writeHeader(header);
+    stream_->flush();
   }
 }
 
 void File::openIfNeeded(const bool create_new) {
+  std::lock_guard<std::mutex> registry_guard(registry_latch_);
   if (open_counts_.find(filename_) != open_counts_.end()) {	//exists an entry already
     ++open_counts_[filename_];
     stream_ = open_streams_[filename_];
+    fd_ = open_fds_[filename_];
+    latch_ = open_latches_[filename_];
+    unwritten_ = open_unwritten_[filename_];
+    links_ = open_links_[filename_];
+    id_ = open_ids_[filename_];
+    slot_ = open_slots_[filename_];
   } else {
     std::ios_base::openmode mode =
         std::fstream::in | std::fstream::out | std::fstream::binary;
@@ -253,18 +441,59 @@ void File::openIfNeeded(const bool create_new) {
       }
     }
     stream_.reset(new std::fstream(filename_, mode));
+    fd_ = ::open(filename_.c_str(), O_RDWR);
+    latch_.reset(new std::recursive_mutex());
+    unwritten_.reset(new PageHeaderMap());
+    links_.reset(new PageLinkMap());
     open_streams_[filename_] = stream_;
+    open_fds_[filename_] = fd_;
+    open_latches_[filename_] = latch_;
+    open_unwritten_[filename_] = unwritten_;
+    open_links_[filename_] = links_;
     open_counts_[filename_] = 1;
+    id_ = next_id_++;
+    open_ids_[filename_] = id_;
+    // the slot the file had before, else the lowest free one
+    FreeSlotMap::iterator free = free_slots_.begin();
+    for (FreeSlotMap::iterator it = free_slots_.begin();
+         it != free_slots_.end(); ++it) {
+      if (it->second == filename_) {
+        free = it;
+        break;
+      }
+    }
+    if (free != free_slots_.end()) {
+      slot_ = free->first;
+      free_slots_.erase(free);
+    } else {
+      slot_ = next_slot_++;
+    }
+    open_slots_[filename_] = slot_;
   }
 }
 
 void File::close() {
+  std::lock_guard<std::mutex> registry_guard(registry_latch_);
   if (stream_) {
     --open_counts_[filename_];
     stream_.reset();
+    fd_ = -1;
+    latch_.reset();
+    unwritten_.reset();
+    links_.reset();
     if (open_counts_[filename_] == 0) {
       open_streams_.erase(filename_);
+      if (open_fds_[filename_] >= 0) {
+        ::close(open_fds_[filename_]);
+      }
+      open_fds_.erase(filename_);
       open_counts_.erase(filename_);
+      open_latches_.erase(filename_);
+      open_unwritten_.erase(filename_);
+      open_links_.erase(filename_);
+      open_ids_.erase(filename_);
+      free_slots_[slot_] = filename_;
+      open_slots_.erase(filename_);
     }
   }
 }
@@ -275,11 +504,10 @@ void File::writePage(const PageId page_number, const Page& new_page) {
 
 void File::writePage(const PageId page_number, const PageHeader& header,
                      const Page& new_page) {
+  unwritten_->erase(page_number);
   stream_->seekp(pagePosition(page_number), std::ios::beg);
   stream_->write(reinterpret_cast<const char*>(&header), sizeof(header));
-  stream_->write(new_page.data_.c_str(),
-                 Page::DATA_SIZE);
-  stream_->flush();
+  stream_->write(new_page.data_, Page::DATA_SIZE);
 }
 
 FileHeader File::readHeader() const {
@@ -293,10 +521,13 @@ FileHeader File::readHeader() const {
 void File::writeHeader(const FileHeader& header) {
   stream_->seekp(0 /* pos */, std::ios::beg);
   stream_->write(reinterpret_cast<const char*>(&header), sizeof(header));
-  stream_->flush();
 }
 
 PageHeader File::readPageHeader(PageId page_number) const {
+  PageHeaderMap::const_iterator unwritten = unwritten_->find(page_number);
+  if (unwritten != unwritten_->end()) {
+    return unwritten->second;
+  }
   PageHeader header;
   stream_->seekg(pagePosition(page_number), std::ios::beg);
   stream_->read(reinterpret_cast<char*>(&header), sizeof(header));
@@ -304,4 +535,20 @@ PageHeader File::readPageHeader(PageId page_number) const {
   return header;
 }
 
+void File::writeLinks(const Page& page) {
+  recordLink(page.page_number(), page);
+  PageHeaderMap::iterator unwritten = unwritten_->find(page.page_number());
+  if (unwritten != unwritten_->end()) {
+    unwritten->second.next_page_number = page.next_page_number();
+  } else {
+    writePage(page.page_number(), page);
+  }
+}
+
+void File::recordLink(const PageId page_number, const Page& page) {
+  PageLink& link = (*links_)[page_number];
+  link.next_page_number = page.next_page_number();
+  link.used = page.isUsed();
+}
+
 }
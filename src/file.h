@@ -11,6 +11,8 @@
 #include <string>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 #include "page.h"
 
@@ -18,6 +20,28 @@ namespace badgerdb {
 
 class FileIterator;
 
+/**
+ * @brief How far File::sync() pushes the file's writes towards the disk.
+ */
+enum class SyncPolicy {
+  /**
+   * Leave buffered writes where they are.
+   */
+  NONE,
+
+  /**
+   * Hand buffered writes to the operating system, so other processes see
+   * them and they survive a crash of this process.
+   */
+  FLUSH,
+
+  /**
+   * Also wait until the operating system has written the file's data to the
+   * disk, so the writes survive a crash of the machine.
+   */
+  FDATASYNC
+};
+
 /**
  * @brief Header metadata for files on disk which contain pages.
  */
@@ -56,6 +80,21 @@ struct FileHeader {
   }
 };
 
+/**
+ * @brief Place of a page in its file's used or free list.
+ */
+struct PageLink {
+  /**
+   * Page number of the next page in the list.
+   */
+  PageId next_page_number;
+
+  /**
+   * Whether the page is in the used list rather than the free list.
+   */
+  bool used;
+};
+
 /**
  * @brief Class which represents a file in the filesystem containing database
  *        pages.
@@ -68,10 +107,21 @@ struct FileHeader {
  * detects this (by looking in the open_streams_ map) and just returns a file object with
  * the already created stream for the file without actually opening the UNIX file again. 
  *
- * @warning This class is not threadsafe.
+ * Page operations (allocatePage, readPage, writePage, deletePage) hold a latch
+ * shared by all File objects on the same underlying file, and opening and
+ * closing files is serialized, so File objects may be used from several
+ * threads at once.
+ *
+ * @warning FileIterator is not threadsafe.
  */
 class File {
  public:
+  /**
+   * File identifier indicating that it's invalid.  Never assigned to an open
+   * file, so a page key with this identifier never names a real page.
+   */
+  static const FileId INVALID_ID = 0;
+
   /**
    * Creates a new file.
    *
@@ -152,6 +202,21 @@ class File {
    */
   Page allocatePage();
 
+  /**
+   * Allocates a new page in the file and builds it in the caller's memory,
+   * such as a buffer pool frame, instead of returning a copy.
+   *
+   * With defer_write set, the new page is not written: the file only records
+   * it in memory, and it first reaches the disk when the caller writes it
+   * with writePage().  Until then, reading the page through this file
+   * returns the new, empty page.  The caller must write the page before the
+   * file is closed.
+   *
+   * @param new_page    Page to fill with the new page.
+   * @param defer_write Whether to leave writing the new page to the caller.
+   */
+  void allocatePage(Page& new_page, const bool defer_write = false);
+
   /**
    * Reads an existing page from the file.
    *
@@ -162,6 +227,33 @@ class File {
    */
   Page readPage(const PageId page_number) const;
 
+  /**
+   * Reads an existing page from the file straight into the caller's memory,
+   * such as a buffer pool frame, header and data in a single read.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Page to read into.  Its contents are undefined if an
+   *                      exception is thrown.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   */
+  void readPage(const PageId page_number, Page& page) const;
+
+  /**
+   * Reads several existing pages from the file, in the given order, holding
+   * the file latch once for all of them.  Callers should list the pages in
+   * the order of their position in the file.
+   *
+   * @param page_numbers  Numbers of the pages to read.
+   * @param pages         The page read for page_numbers[i] is stored in
+   *                      *pages[i].
+   * @throws  InvalidPageException  If one of the pages doesn't exist in the
+   *                                file or is not currently used; the pages
+   *                                before it have been read.
+   */
+  void readPages(const std::vector<PageId>& page_numbers,
+                 const std::vector<Page*>& pages) const;
+
   /**
    * Writes a page into the file, replacing any existing contents.  The page
    * must have been already allocated in this file by a call to allocatePage().
@@ -171,6 +263,34 @@ class File {
    */
   void writePage(const Page& new_page);
 
+  /**
+   * Writes several pages into the file, as writePage() does for each of them.
+   * The pages are written in the order of their position in the file, and
+   * runs of adjacent pages are written with a single system call.
+   *
+   * @see writePage()
+   * @param pages  Pages to write, in any order.
+   * @throws  InvalidPageException  If one of the pages has been deleted;
+   *                                nothing has been written.
+   */
+  void writePages(const std::vector<const Page*>& pages);
+
+  /**
+   * Function which writePages() calls before it writes a run of adjacent
+   * pages with a single system call, with the first page of the run and the
+   * number of pages in it.  If it returns false, the call is taken to have
+   * failed and the run is written as writePage() would.
+   */
+  typedef bool (*WriteHook)(const PageId first_page, const std::size_t num_pages);
+
+  /**
+   * Sets the function writePages() calls before each run it writes, for
+   * tests; NULL for none.
+   *
+   * @param hook  Function to call.
+   */
+  static void setWriteHook(const WriteHook hook) { write_hook_ = hook; }
+
   /**
    * Deletes a page from the file.
    *
@@ -185,6 +305,38 @@ class File {
    */
   const std::string& filename() const { return filename_; }
 
+  /**
+   * Makes the writes to the file so far durable to the given degree.  Page
+   * writes, and the list updates of allocatePage() and deletePage(), are
+   * buffered and are only guaranteed to leave this process at a sync; all
+   * File objects of a file share the buffer, so they see them before.
+   *
+   * @param policy  How far to push the writes.
+   * @throws  std::system_error  If the writes cannot be flushed, or under
+   *                             SyncPolicy::FDATASYNC the file cannot be
+   *                             synced; the writes may not be durable then.
+   */
+  void sync(const SyncPolicy policy = SyncPolicy::FLUSH) const;
+
+  /**
+   * Returns the identifier of the underlying file.  All File objects open on
+   * the same file share one identifier; identifiers are assigned densely when
+   * a file is first opened and are not reused after it is closed.
+   *
+   * @return Identifier of file.
+   */
+  FileId id() const { return id_; }
+
+  /**
+   * Returns the slot of the underlying file: a small number which no other
+   * open file has.  All File objects open on the same file share the slot;
+   * slots are reused once a file is closed, and a file which is reopened
+   * gets its old slot back if no other file has taken it meanwhile.
+   *
+   * @return Slot of file.
+   */
+  std::uint32_t slot() const { return slot_; }
+
   /**
    * Returns an iterator at the first page in the file.
    *
@@ -256,6 +408,19 @@ class File {
    */
   Page readPage(const PageId page_number, const bool allow_free) const;
 
+  /**
+   * Reads a page from the file into the given page, like
+   * readPage(page_number, allow_free).
+   *
+   * @param page_number   Number of page to read.
+   * @param allow_free    Whether to allow reading a free (unused) page.
+   * @param page          Page to read into.
+   * @throws  InvalidPageException  If the page is free (unused) and
+   *                                allow_free is false.
+   */
+  void readPage(const PageId page_number, const bool allow_free,
+                Page& page) const;
+
   /**
    * Writes a page into the file at the given page number.  This does not
    * update ensure that the number in the header equals the position on disk.
@@ -301,9 +466,30 @@ class File {
    */
   PageHeader readPageHeader(const PageId page_number) const;
 
+  /**
+   * Writes a page whose header this file has changed, to update its place in
+   * the used or free list.  A page which has not been written yet only has
+   * its header updated in memory.
+   *
+   * @param page  Page to write.
+   */
+  void writeLinks(const Page& page);
+
   typedef std::map<std::string,
                    std::shared_ptr<std::fstream> > StreamMap;
   typedef std::map<std::string, int> CountMap;
+  typedef std::map<std::string, int> DescriptorMap;
+  typedef std::map<std::string, FileId> IdMap;
+  typedef std::map<std::string, std::uint32_t> SlotMap;
+  typedef std::map<std::uint32_t, std::string> FreeSlotMap;
+  typedef std::map<std::string,
+                   std::shared_ptr<std::recursive_mutex> > LatchMap;
+  typedef std::map<PageId, PageHeader> PageHeaderMap;
+  typedef std::map<std::string,
+                   std::shared_ptr<PageHeaderMap> > UnwrittenMap;
+  typedef std::map<PageId, PageLink> PageLinkMap;
+  typedef std::map<std::string,
+                   std::shared_ptr<PageLinkMap> > LinksMap;
 
   /**
    * Streams for opened files.
@@ -315,6 +501,61 @@ class File {
    */
   static CountMap open_counts_;
 
+  /**
+   * Descriptors for opened files, next to their streams.
+   */
+  static DescriptorMap open_fds_;
+
+  /**
+   * Identifiers for opened files.
+   */
+  static IdMap open_ids_;
+
+  /**
+   * Identifier to assign to the next file that is opened.
+   */
+  static FileId next_id_;
+
+  /**
+   * Slots of opened files.
+   */
+  static SlotMap open_slots_;
+
+  /**
+   * Slots of closed files, with the name of the file which had each.
+   */
+  static FreeSlotMap free_slots_;
+
+  /**
+   * Slot to assign to the next file that is opened when none is free.
+   */
+  static std::uint32_t next_slot_;
+
+  /**
+   * Latches serializing page operations on opened files.
+   */
+  static LatchMap open_latches_;
+
+  /**
+   * Pages of opened files which were allocated with a deferred write.
+   */
+  static UnwrittenMap open_unwritten_;
+
+  /**
+   * Page list links of opened files changed since they were opened.
+   */
+  static LinksMap open_links_;
+
+  /**
+   * Function writePages() calls before each run it writes.
+   */
+  static WriteHook write_hook_;
+
+  /**
+   * Protects the maps of opened files, next_id_ and the slots.
+   */
+  static std::mutex registry_latch_;
+
   /**
    * Name of the file this object represents.
    */
@@ -325,6 +566,52 @@ class File {
    */
   std::shared_ptr<std::fstream> stream_;
 
+  /**
+   * Descriptor of the underlying file, shared like the stream, for the calls
+   * the stream cannot make; -1 if it could not be opened.
+   */
+  int fd_;
+
+  /**
+   * Latch serializing page operations on the underlying file.  Recursive
+   * because allocatePage and deletePage read pages through FileIterator.
+   */
+  std::shared_ptr<std::recursive_mutex> latch_;
+
+  /**
+   * Headers of the pages which were allocated with a deferred write and have
+   * not been written since, shared like the latch.
+   */
+  std::shared_ptr<PageHeaderMap> unwritten_;
+
+  /**
+   * Pages whose next page pointer or use this file has changed since it was
+   * opened, with their current values, shared like the latch.  Copies of
+   * these pages read before the change are stale, so writePage() takes the
+   * link from here instead of reading it back from disk.  Once writePage()
+   * or writePages() writes a copy which already has the link, the copy that
+   * is written back is current and the entry is erased.
+   */
+  std::shared_ptr<PageLinkMap> links_;
+
+  /**
+   * Records the current link of a page whose list linkage has changed.
+   *
+   * @param page_number   Number of the page.
+   * @param page          Page as written.
+   */
+  void recordLink(const PageId page_number, const Page& page);
+
+  /**
+   * Identifier of the underlying file.
+   */
+  FileId id_;
+
+  /**
+   * Slot of the underlying file.
+   */
+  std::uint32_t slot_;
+
   friend class FileIterator;
   friend class FileTest;
 };
@@ -0,0 +1,66 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <thread>
+
+namespace badgerdb {
+
+/**
+ * @brief Test-and-test-and-set spin latch for very short critical sections.
+ *
+ * The latch is a single byte, so one can be embedded in every buffer frame
+ * descriptor.  It satisfies the Lockable requirements and can be used with
+ * std::lock_guard.  Waiters yield instead of burning the core, but the latch
+ * must still never be held across I/O or while acquiring another latch that
+ * may itself be held for long.
+ */
+class SpinLatch {
+ public:
+  /**
+   * Constructs an unlocked latch.
+   */
+  SpinLatch() : locked_(false) {}
+
+  /**
+   * Acquires the latch, waiting as long as necessary.
+   */
+  void lock() {
+    while (locked_.exchange(true, std::memory_order_acquire)) {
+      while (locked_.load(std::memory_order_relaxed)) {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  /**
+   * Acquires the latch if it is free.
+   *
+   * @return  True if the latch was acquired.
+   */
+  bool try_lock() {
+    return !locked_.load(std::memory_order_relaxed) &&
+        !locked_.exchange(true, std::memory_order_acquire);
+  }
+
+  /**
+   * Releases the latch.
+   */
+  void unlock() {
+    locked_.store(false, std::memory_order_release);
+  }
+
+ private:
+  /**
+   * True while some thread holds the latch.
+   */
+  std::atomic<bool> locked_;
+};
+
+}
@@ -1,10 +1,18 @@
 #include <iostream>
 #include <stdlib.h>
 //#include <stdio.h>
+#include <cstdio>
 #include <cstring>
 #include <memory>
+#include <atomic>
+#include <cmath>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <system_error>
 #include "page.h"
 #include "buffer.h"
+#include "bufPoolSet.h"
 #include "file_iterator.h"
 #include "page_iterator.h"
 #include "exceptions/file_not_found_exception.h"
@@ -12,6 +20,8 @@
 #include "exceptions/page_not_pinned_exception.h"
 #include "exceptions/page_pinned_exception.h"
 #include "exceptions/buffer_exceeded_exception.h"
+#include "exceptions/pool_exists_exception.h"
+#include "exceptions/pool_not_found_exception.h"
 
 #define PRINT_ERROR(str) \
 { \
@@ -23,6 +33,10 @@
 #include <sys/types.h>
 #include <unistd.h>
 #include <sys/wait.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+
+void syncFiles();
 
 int fork_test(void (*test)())
 {
@@ -38,6 +52,9 @@ int fork_test(void (*test)())
 	else {
 		// no return!
 		test();
+		// the child never closes the files, so their buffered writes are
+		// pushed out here for the tests which follow
+		syncFiles();
 		exit(0);
 	}
 }
@@ -48,16 +65,51 @@ const PageId num = 100;
 PageId pid[num], pageno1, pageno2, pageno3, i;
 RecordId rid[num], rid2, rid3;
 Page *page, *page2, *page3;
+// Runs of pages File::writePages() wrote with one call, seen through its
+// write hook, which makes them fail while writesFail is set
+std::vector<std::pair<PageId, std::size_t> > writeRuns;
+bool writesFail = false;
+
+bool recordWrite(const PageId firstPage, const std::size_t numPages)
+{
+	writeRuns.push_back(std::make_pair(firstPage, numPages));
+	return !writesFail;
+}
+
 char tmpbuf[100];
 BufMgr* bufMgr;
 File *file1ptr, *file2ptr, *file3ptr, *file4ptr, *file5ptr;
 
+void syncFiles()
+{
+	for (File *file : {file1ptr, file2ptr, file3ptr, file4ptr, file5ptr})
+		file->sync();
+}
+
 void test1();
 void test2();
 void test3();
 void test4();
 void test5();
 void test6();
+void test7();
+void test8();
+void test9();
+void test10();
+void test11();
+void test12();
+void test13();
+void test14();
+void test15();
+void test16();
+void test17();
+void test18();
+void test19();
+void test20();
+void test21();
+void test22();
+void test23();
+void test24();
 void testBufMgr();
 
 int main() 
@@ -172,6 +224,24 @@ void testBufMgr()
 	fork_test(test4);
 	fork_test(test5);
 	fork_test(test6);
+	fork_test(test7);
+	fork_test(test8);
+	fork_test(test9);
+	fork_test(test10);
+	fork_test(test11);
+	fork_test(test12);
+	fork_test(test13);
+	fork_test(test14);
+	fork_test(test15);
+	fork_test(test16);
+	fork_test(test17);
+	fork_test(test18);
+	fork_test(test19);
+	fork_test(test20);
+	fork_test(test21);
+	fork_test(test22);
+	fork_test(test23);
+	fork_test(test24);
 
 	//Close files before deleting them
 	file1.close();
@@ -336,3 +406,893 @@ void test6()
 
 	bufMgr->flushFile(file1ptr);
 }
+
+void test7()
+{
+	//Reading the same pages from several threads at once
+	std::atomic<int> errors(0);
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; t++)
+	{
+		threads.push_back(std::thread([&errors]() {
+			Page *threadPage;
+			for (PageId j = 1; j <= num; j++)
+			{
+				bufMgr->readPage(file1ptr, j, threadPage);
+				if (threadPage->page_number() != j)
+					errors++;
+				bufMgr->unPinPage(file1ptr, j, false);
+			}
+		}));
+	}
+	for (std::thread &th : threads)
+		th.join();
+
+	if (errors > 0)
+	{
+		PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+	}
+
+	std::cout << "Test 7 passed" << "\n";
+}
+
+void test8()
+{
+	//Every replacement policy has to hand out the right pages under eviction pressure
+	const ReplacementPolicy policies[] = {ReplacementPolicy::CLOCK, ReplacementPolicy::LRU_K,
+		ReplacementPolicy::TWO_Q, ReplacementPolicy::ARC, ReplacementPolicy::CLOCK_PRO};
+	for (const ReplacementPolicy policy : policies)
+	{
+		BufMgr policyMgr(num / 10, BufMgr::DEFAULT_PARTITIONS, policy);
+		//keep two pages pinned so victims have to be skipped
+		policyMgr.readPage(file1ptr, 1, page);
+		policyMgr.readPage(file1ptr, 2, page);
+		for (int round = 0; round < 3; round++)
+		{
+			for (PageId j = 1; j <= num; j++)
+			{
+				//keep coming back to the first few pages
+				const PageId pageNo = (j % 3 == 0) ? j % 5 + 1 : j;
+				policyMgr.readPage(file1ptr, pageNo, page);
+				if (page->page_number() != pageNo)
+				{
+					PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+				}
+				policyMgr.unPinPage(file1ptr, pageNo, false);
+			}
+		}
+		policyMgr.unPinPage(file1ptr, 1, false);
+		policyMgr.unPinPage(file1ptr, 2, false);
+
+		const BufStats &stats = policyMgr.getBufStats();
+		if (stats.accesses != 3 * (int)num + 2 || stats.diskreads <= 0 || stats.diskreads >= stats.accesses)
+		{
+			PRINT_ERROR("ERROR :: WRONG BUFFER STATISTICS FOR " << Replacer::name(policy));
+		}
+	}
+
+	std::cout << "Test 8 passed" << "\n";
+}
+
+void test9()
+{
+	//A scan through a ring must not push the pages in use out of the pool
+	BufMgr ringMgr(num / 5);
+	for (int round = 0; round < 2; round++)
+	{
+		for (PageId j = 1; j <= 10; j++)
+		{
+			ringMgr.readPage(file2ptr, j, page);
+			ringMgr.unPinPage(file2ptr, j, false);
+		}
+	}
+
+	{
+		BufRing ring(ringMgr);
+		for (PageId j = 1; j <= num; j++)
+		{
+			ringMgr.readPage(file1ptr, j, page, ring);
+			if (page->page_number() != j)
+			{
+				PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+			}
+			ringMgr.unPinPage(file1ptr, j, false);
+		}
+	}
+
+	const std::uint64_t diskreads = ringMgr.getBufStats().diskreads;
+	for (PageId j = 1; j <= 10; j++)
+	{
+		ringMgr.readPage(file2ptr, j, page);
+		ringMgr.unPinPage(file2ptr, j, false);
+	}
+	if (ringMgr.getBufStats().diskreads != diskreads)
+	{
+		PRINT_ERROR("ERROR :: SCAN EVICTED PAGES IN USE");
+	}
+
+	std::cout << "Test 9 passed" << "\n";
+}
+
+void test10()
+{
+	//With the background writer running, misses find clean victims
+	BufMgr bgMgr(num / 10);
+	PageId first = 0;
+	for (PageId j = 0; j < num / 10; j++)
+	{
+		bgMgr.allocPage(file3ptr, pageno3, page3);
+		if (j == 0)
+			first = pageno3;
+		bgMgr.unPinPage(file3ptr, pageno3, true);
+	}
+
+	bgMgr.startBgWriter(num / 10, 10);
+	for (int wait = 0; wait < 500 && bgMgr.getBufStats().bgwrites < (int)(num / 10); wait++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	bgMgr.stopBgWriter();
+	if (bgMgr.getBufStats().bgwrites < (int)(num / 10))
+	{
+		PRINT_ERROR("ERROR :: BACKGROUND WRITER DID NOT CLEAN THE POOL");
+	}
+
+	for (PageId j = 0; j < num / 10; j++)
+	{
+		bgMgr.readPage(file1ptr, j + 1, page);
+		bgMgr.unPinPage(file1ptr, j + 1, false);
+	}
+	const BufStats &stats = bgMgr.getBufStats();
+	if (stats.dirtyevictions != 0 || stats.cleanevictions != (int)(num / 10))
+	{
+		PRINT_ERROR("ERROR :: MISSES HAD TO WRITE BACK THEIR VICTIMS");
+	}
+
+	//the written pages must be readable from the file
+	bgMgr.readPage(file3ptr, first, page3);
+	if (page3->page_number() != first)
+	{
+		PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+	}
+	bgMgr.unPinPage(file3ptr, first, false);
+
+	std::cout << "Test 10 passed" << "\n";
+}
+
+void test11()
+{
+	//Prefetched pages are read once, by the prefetch thread
+	BufMgr prefetchMgr(num / 5);
+	prefetchMgr.prefetch(file1ptr, 1, 5);
+	for (PageId j = 1; j <= 5; j++)
+	{
+		prefetchMgr.readPage(file1ptr, j, page);
+		if (page->page_number() != j)
+		{
+			PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+		}
+		prefetchMgr.unPinPage(file1ptr, j, false);
+	}
+
+	const BufStats &stats = prefetchMgr.getBufStats();
+	if (stats.diskreads != 0 || stats.prefetchreads != 5)
+	{
+		PRINT_ERROR("ERROR :: PREFETCHED PAGES WERE READ AGAIN");
+	}
+
+	std::cout << "Test 11 passed" << "\n";
+}
+
+void test12()
+{
+	//A batch pins every listed page, reading each missing page once
+	BufMgr batchMgr(num / 5);
+	std::vector<PageId> pageNos = {3, 1, 2, 3};
+	std::vector<Page*> pages;
+	batchMgr.readPages(file1ptr, pageNos, pages);
+	for (std::size_t j = 0; j < pageNos.size(); j++)
+	{
+		if (pages[j]->page_number() != pageNos[j])
+		{
+			PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+		}
+	}
+	if (batchMgr.getBufStats().diskreads != 3)
+	{
+		PRINT_ERROR("ERROR :: BATCH READ A PAGE TWICE");
+	}
+	batchMgr.unPinPages(file1ptr, pageNos, false);
+	try
+	{
+		batchMgr.unPinPage(file1ptr, 3, false);
+		PRINT_ERROR("ERROR :: Page is already unpinned. Exception should have been thrown before execution reaches this point.");
+	}
+	catch(const PageNotPinnedException &e)
+	{
+	}
+
+	//A batch which does not fit pins nothing
+	pageNos.clear();
+	for (PageId j = 1; j <= num / 5 + 1; j++)
+		pageNos.push_back(j);
+	try
+	{
+		batchMgr.readPages(file1ptr, pageNos, pages);
+		PRINT_ERROR("ERROR :: No more frames left for allocation. Exception should have been thrown before execution reaches this point.");
+	}
+	catch(const BufferExceededException &e)
+	{
+	}
+	pageNos.pop_back();
+	batchMgr.readPages(file1ptr, pageNos, pages);
+	batchMgr.unPinPages(file1ptr, pageNos, false);
+
+	std::cout << "Test 12 passed" << "\n";
+}
+
+void test13()
+{
+	//Handles unpin their pages when they go out of scope
+	BufMgr handleMgr(num / 10);
+	PageId first = 0;
+	RecordId last;
+	for (PageId j = 0; j < num / 10; j++)
+	{
+		PageHandle handle = handleMgr.allocPage(file4ptr, pageno1);
+		if (j == 0)
+			first = pageno1;
+		last = handle->insertRecord("handle record");
+	}
+
+	//every frame was unpinned, so the pool can be filled again
+	std::vector<PageHandle> handles;
+	for (PageId j = 0; j < num / 10; j++)
+	{
+		handles.push_back(handleMgr.readPage(file4ptr, first + j));
+		if (handles.back()->page_number() != first + j)
+		{
+			PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+		}
+	}
+	PageHandle moved = std::move(handles.back());
+	handles.pop_back();
+	if (!moved || moved->getRecord(last) != "handle record")
+	{
+		PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+	}
+	moved.release();
+	handles.clear();
+	try
+	{
+		handleMgr.unPinPage(file4ptr, first, false);
+		PRINT_ERROR("ERROR :: Page is already unpinned. Exception should have been thrown before execution reaches this point.");
+	}
+	catch(const PageNotPinnedException &e)
+	{
+	}
+
+	std::cout << "Test 13 passed" << "\n";
+}
+
+void test14()
+{
+	//Deferred pages reach the disk once, when they are written back
+	PageId first = 0;
+	RecordId last;
+	{
+		BufMgr deferMgr(num / 10);
+		for (PageId j = 0; j < num / 10; j++)
+		{
+			deferMgr.allocPage(file5ptr, pageno1, page, true);
+			if (j == 0)
+				first = pageno1;
+			last = page->insertRecord("deferred record");
+			deferMgr.unPinPage(file5ptr, pageno1, false);
+		}
+		if (deferMgr.getBufStats().diskwrites != 0)
+		{
+			PRINT_ERROR("ERROR :: DEFERRED PAGE WAS WRITTEN AT ALLOCATION");
+		}
+		if (deferMgr.getBufStats().diskreads != 0)
+		{
+			PRINT_ERROR("ERROR :: DEFERRED PAGE WAS COUNTED AS READ");
+		}
+		//the file knows the page, but not its contents yet
+		Page unwritten = file5ptr->readPage(first);
+		if (unwritten.page_number() != first || unwritten.begin() != unwritten.end())
+		{
+			PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+		}
+	}
+
+	Page written = file5ptr->readPage(last.page_number);
+	if (written.getRecord(last) != "deferred record")
+	{
+		PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+	}
+
+	std::cout << "Test 14 passed" << "\n";
+}
+
+void test15()
+{
+	//Dropping a file takes only its own pages out of the pool
+	BufMgr dropMgr(num / 10);
+	for (PageId j = 1; j <= 5; j++)
+	{
+		dropMgr.readPage(file1ptr, j, page);
+		dropMgr.unPinPage(file1ptr, j, false);
+		dropMgr.readPage(file2ptr, j, page2);
+		dropMgr.unPinPage(file2ptr, j, true);
+	}
+	dropMgr.dropFile(file2ptr);
+	dropMgr.clearBufStats();
+
+	dropMgr.readPage(file1ptr, 1, page);
+	if (dropMgr.getBufStats().diskreads != 0)
+	{
+		PRINT_ERROR("ERROR :: PAGE OF ANOTHER FILE WAS DROPPED");
+	}
+	dropMgr.readPage(file2ptr, 1, page2);
+	dropMgr.unPinPage(file2ptr, 1, false);
+	if (dropMgr.getBufStats().diskreads != 1 || dropMgr.getBufStats().diskwrites != 0)
+	{
+		PRINT_ERROR("ERROR :: DROPPED PAGE WAS STILL RESIDENT OR WRITTEN BACK");
+	}
+
+	//a pinned page keeps its file from being dropped
+	try
+	{
+		dropMgr.dropFile(file1ptr);
+		PRINT_ERROR("ERROR :: Page is still pinned. Exception should have been thrown before execution reaches this point.");
+	}
+	catch(const PagePinnedException &e)
+	{
+	}
+	dropMgr.unPinPage(file1ptr, 1, false);
+	dropMgr.dropFile(file1ptr);
+
+	std::cout << "Test 15 passed" << "\n";
+}
+
+void test16()
+{
+	//The pool grows and shrinks under pinned pages, which stay where they are
+	BufMgr resizeMgr(num / 10, BufMgr::DEFAULT_PARTITIONS, ReplacementPolicy::CLOCK,
+	                 BufMgr::ARENA_HUGE_PAGES, num / 5);
+	Page* first;
+	resizeMgr.readPage(file1ptr, 1, first);
+	const RecordId firstRid = first->insertRecord("resize record");
+	for (PageId j = 2; j <= num / 10; j++)
+	{
+		resizeMgr.readPage(file1ptr, j, page);
+	}
+	resizeMgr.resize(num / 5);
+	for (PageId j = num / 10 + 1; j <= num / 5; j++)
+	{
+		resizeMgr.readPage(file1ptr, j, page);
+	}
+	try
+	{
+		resizeMgr.readPage(file1ptr, num / 5 + 1, page);
+		PRINT_ERROR("ERROR :: No more frames left for allocation. Exception should have been thrown before execution reaches this point.");
+	}
+	catch(const BufferExceededException &e)
+	{
+	}
+
+	//pages pinned in the frames to remove keep the pool from shrinking
+	try
+	{
+		resizeMgr.resize(num / 20);
+		PRINT_ERROR("ERROR :: Page is still pinned. Exception should have been thrown before execution reaches this point.");
+	}
+	catch(const PagePinnedException &e)
+	{
+	}
+	for (PageId j = 2; j <= num / 5; j++)
+	{
+		resizeMgr.unPinPage(file1ptr, j, true);
+	}
+	resizeMgr.clearBufStats();
+	resizeMgr.resize(num / 20);
+	if (resizeMgr.size() != num / 20 || resizeMgr.getBufStats().diskwrites != num / 5 - num / 20)
+	{
+		PRINT_ERROR("ERROR :: POOL WAS NOT SHRUNK");
+	}
+	if (first->page_number() != 1 || first->getRecord(firstRid) != "resize record")
+	{
+		PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+	}
+	for (PageId j = 2; j <= num / 20; j++)
+	{
+		resizeMgr.readPage(file1ptr, j, page);
+	}
+	try
+	{
+		resizeMgr.readPage(file1ptr, num / 20 + 1, page);
+		PRINT_ERROR("ERROR :: No more frames left for allocation. Exception should have been thrown before execution reaches this point.");
+	}
+	catch(const BufferExceededException &e)
+	{
+	}
+	try
+	{
+		resizeMgr.resize(num / 5 + 1);
+		PRINT_ERROR("ERROR :: Pool cannot grow that far. Exception should have been thrown before execution reaches this point.");
+	}
+	catch(const BufferExceededException &e)
+	{
+	}
+	resizeMgr.resize(num / 5);
+	resizeMgr.readPage(file1ptr, num / 20 + 1, page);
+
+	std::cout << "Test 16 passed" << "\n";
+}
+
+void test17()
+{
+	//A file bound to a pool of its own keeps its pages through scans of other files
+	BufPoolSet pools(num / 10);
+	pools.createPool("index", 3);
+	pools.bindFile(file2ptr, "index");
+	for (PageId j = 1; j <= 3; j++)
+	{
+		pools.readPage(file2ptr, j, page2);
+		pools.unPinPage(file2ptr, j, false);
+	}
+	for (PageId j = 1; j <= num / 2; j++)
+	{
+		pools.readPage(file1ptr, j, page);
+		pools.unPinPage(file1ptr, j, false);
+	}
+	BufMgr& indexPool = pools.pool("index");
+	indexPool.clearBufStats();
+	for (PageId j = 1; j <= 3; j++)
+	{
+		pools.readPage(file2ptr, j, page2);
+		pools.unPinPage(file2ptr, j, false);
+	}
+	if (indexPool.getBufStats().diskreads != 0 || &pools.poolOf(file1ptr) != &pools.defaultPool())
+	{
+		PRINT_ERROR("ERROR :: PAGES OF THE BOUND FILE WERE EVICTED");
+	}
+
+	try
+	{
+		pools.createPool("index", 3);
+		PRINT_ERROR("ERROR :: Pool exists already. Exception should have been thrown before execution reaches this point.");
+	}
+	catch(const PoolExistsException &e)
+	{
+	}
+	try
+	{
+		pools.bindFile(file3ptr, "missing");
+		PRINT_ERROR("ERROR :: Pool does not exist. Exception should have been thrown before execution reaches this point.");
+	}
+	catch(const PoolNotFoundException &e)
+	{
+	}
+
+	//a pinned page keeps its file from moving to another pool
+	pools.readPage(file2ptr, 1, page2);
+	try
+	{
+		pools.unbindFile(file2ptr);
+		PRINT_ERROR("ERROR :: Page is still pinned. Exception should have been thrown before execution reaches this point.");
+	}
+	catch(const PagePinnedException &e)
+	{
+	}
+	pools.unPinPage(file2ptr, 1, false);
+	pools.unbindFile(file2ptr);
+	pools.defaultPool().clearBufStats();
+	pools.readPage(file2ptr, 1, page2);
+	pools.unPinPage(file2ptr, 1, false);
+	if (&pools.poolOf(file2ptr) != &pools.defaultPool() || pools.defaultPool().getBufStats().diskreads != 1)
+	{
+		PRINT_ERROR("ERROR :: FILE WAS NOT MOVED TO THE DEFAULT POOL");
+	}
+
+	//a file keeps its pool when it is closed and opened again
+	{
+		File bound = File::create("test.b");
+		pools.bindFile(&bound, "index");
+	}
+	{
+		File bound = File::open("test.b");
+		if (&pools.poolOf(&bound) != &indexPool)
+		{
+			PRINT_ERROR("ERROR :: REOPENED FILE LOST ITS POOL");
+		}
+		pools.unbindFile(&bound);
+	}
+	File::remove("test.b");
+
+	//reads through a ring and optimistic reads go to the pool of the file too
+	pools.bindFile(file2ptr, "index");
+	indexPool.clearBufStats();
+	{
+		BufRing ring(indexPool, 2);
+		pools.readPage(file2ptr, 4, page2, ring);
+		pools.unPinPage(file2ptr, 4, false);
+	}
+	pools.readPageOptimistic(file2ptr, 4, [](const Page &) {});
+	if (indexPool.getBufStats().accesses != 2 || pools.getFileStats(file2ptr).accesses != 2)
+	{
+		PRINT_ERROR("ERROR :: READS WERE NOT FORWARDED TO THE POOL OF THE FILE");
+	}
+
+	std::cout << "Test 17 passed" << "\n";
+}
+
+void test18()
+{
+	//Counters are kept for the pool and for each file, and can be watched from outside
+	BufMgr statsMgr(num / 10);
+	for (int round = 0; round < 2; round++)
+	{
+		for (PageId j = 1; j <= 3; j++)
+		{
+			statsMgr.readPage(file1ptr, j, page);
+			statsMgr.unPinPage(file1ptr, j, round == 0);
+		}
+	}
+	statsMgr.readPage(file2ptr, 1, page2);
+	statsMgr.unPinPage(file2ptr, 1, false);
+	BufStats &stats = statsMgr.getBufStats();
+	BufCounters &file1Stats = statsMgr.getFileStats(file1ptr);
+	BufCounters &file2Stats = statsMgr.getFileStats(file2ptr);
+	if (stats.accesses != 7 || stats.hits() != 3 || stats.misses != 4 || stats.diskreads != 4
+			|| file1Stats.accesses != 6 || file1Stats.hits() != 3 || file1Stats.misses != 3
+			|| file2Stats.accesses != 1 || file2Stats.misses != 1)
+	{
+		PRINT_ERROR("ERROR :: HITS AND MISSES WERE NOT COUNTED");
+	}
+
+	//fill the pool with pages of file2 so the dirty pages of file1 are evicted
+	for (PageId j = 2; j <= 2 * num / 10; j++)
+	{
+		statsMgr.readPage(file2ptr, j, page2);
+		statsMgr.unPinPage(file2ptr, j, false);
+	}
+	if (file1Stats.dirtyevictions != 3 || file1Stats.diskwrites != 3 || file2Stats.dirtyevictions != 0
+			|| file2Stats.cleanevictions != 10 || stats.cleanevictions + stats.dirtyevictions != 13
+			|| stats.sweeps < 13 || stats.sweepsteps < stats.sweeps)
+	{
+		PRINT_ERROR("ERROR :: EVICTIONS WERE NOT COUNTED FOR THEIR FILE");
+	}
+
+	statsMgr.exportStats("/badgerdb_test18", 10);
+	const int fd = shm_open("/badgerdb_test18", O_RDONLY, 0);
+	if (fd < 0)
+	{
+		PRINT_ERROR("ERROR :: STATISTICS WERE NOT EXPORTED");
+	}
+	void *mem = mmap(NULL, sizeof(BufStatsRegion), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	const BufStatsRegion *region = static_cast<const BufStatsRegion *>(mem);
+	if (mem == MAP_FAILED || region->magic != BufStatsRegion::MAGIC || region->frames != num / 10
+			|| region->totals.accesses != stats.accesses || region->numFiles != 2
+			|| region->files[0].name != file1ptr->filename() || region->files[0].counters.dirtyevictions != 3)
+	{
+		PRINT_ERROR("ERROR :: EXPORTED STATISTICS DID NOT MATCH");
+	}
+	munmap(mem, sizeof(BufStatsRegion));
+	statsMgr.stopExportStats();
+	if (shm_open("/badgerdb_test18", O_RDONLY, 0) >= 0)
+	{
+		PRINT_ERROR("ERROR :: EXPORTED STATISTICS WERE NOT REMOVED");
+	}
+
+	std::cout << "Test 18 passed" << "\n";
+}
+
+void test19()
+{
+	//Page accesses are recorded in order while a trace is taken
+	BufMgr traceMgr(num / 10);
+	File handleFile = File::create("test.h");
+	PageId handlePageNo;
+	traceMgr.allocPage(&handleFile, handlePageNo, page);
+	traceMgr.unPinPage(&handleFile, handlePageNo, false);
+	traceMgr.readPage(file1ptr, 1, page);
+	traceMgr.unPinPage(file1ptr, 1, false);
+	traceMgr.startTrace("test.t");
+	traceMgr.readPage(file1ptr, 1, page);
+	traceMgr.readPage(file1ptr, 2, page2);
+	traceMgr.unPinPage(file1ptr, 2, true);
+	traceMgr.unPinPage(file1ptr, 1, false);
+	traceMgr.readPageOptimistic(file1ptr, 2, [](const Page&) {});
+	try
+	{
+		traceMgr.unPinPage(file1ptr, 1, false);
+	}
+	catch (const PageNotPinnedException &e)
+	{
+	}
+	//the handle of a page disposed meanwhile has no pin left to release
+	PageHandle handle = traceMgr.readPage(&handleFile, handlePageNo);
+	handle.markDirty();
+	traceMgr.disposePage(&handleFile, handlePageNo);
+	handle.release();
+	traceMgr.stopTrace();
+	traceMgr.readPage(file1ptr, 3, page3);
+	traceMgr.unPinPage(file1ptr, 3, false);
+
+	const TraceOp ops[] = {TraceOp::READ, TraceOp::READ, TraceOp::DIRTY, TraceOp::UNPIN, TraceOp::READ, TraceOp::UNPIN,
+		TraceOp::READ, TraceOp::DISPOSE};
+	const PageId pages[] = {1, 2, 2, 1, 2, 2, handlePageNo, handlePageNo};
+	TraceReader reader("test.t");
+	TraceRecord record;
+	for (int j = 0; j < 8; j++)
+	{
+		const FileId traced = j < 6 ? file1ptr->id() : handleFile.id();
+		if (!reader.next(record) || record.op != ops[j] || record.file != traced || record.pageNo != pages[j])
+		{
+			PRINT_ERROR("ERROR :: TRACE DID NOT MATCH");
+		}
+	}
+	if (reader.next(record))
+	{
+		PRINT_ERROR("ERROR :: FAILED UNPINS OR EVENTS AFTER THE TRACE WAS STOPPED WERE TRACED");
+	}
+	std::remove("test.t");
+	handleFile.close();
+	File::remove("test.h");
+
+	std::cout << "Test 19 passed" << "\n";
+}
+
+void test20()
+{
+	//Cycling over 10 pages misses at every size below 10 frames and only misses the first reads from 10 frames on
+	BufMgr curveMgr(num / 5);
+	curveMgr.startMissRatioCurve(1.0, 40);
+	for (int round = 0; round < 5; round++)
+	{
+		for (PageId j = 1; j <= 10; j++)
+		{
+			curveMgr.readPage(file1ptr, j, page);
+			curveMgr.unPinPage(file1ptr, j, false);
+		}
+	}
+	curveMgr.stopMissRatioCurve();
+	curveMgr.readPage(file1ptr, 11, page);
+	curveMgr.unPinPage(file1ptr, 11, false);
+
+	const std::vector<MissRatioPoint> curve = curveMgr.missRatioCurve();
+	if (curve.size() < 40 || curve[8].frames != 9 || curve[8].missRatio != 1.0
+			|| curve[9].frames != 10 || std::abs(curve[9].missRatio - 0.2) > 1e-9
+			|| std::abs(curve[39].missRatio - 0.2) > 1e-9)
+	{
+		PRINT_ERROR("ERROR :: MISS RATIO CURVE DID NOT MATCH THE REUSE DISTANCES");
+	}
+
+	std::cout << "Test 20 passed" << "\n";
+}
+
+void test21()
+{
+	//A flush syncs as the sync policy says and reports a sync which fails
+	{
+		File syncFile = File::create("test.s");
+		BufMgr syncMgr(num / 10);
+		PageId syncPageNo;
+		Page *syncPage;
+		syncMgr.setSyncPolicy(SyncPolicy::FDATASYNC);
+		syncMgr.allocPage(&syncFile, syncPageNo, syncPage);
+		const RecordId rid = syncPage->insertRecord("durable");
+		syncMgr.unPinPage(&syncFile, syncPageNo, true);
+		syncMgr.flushFile(&syncFile);
+		if (syncFile.readPage(syncPageNo).getRecord(rid) != "durable")
+		{
+			PRINT_ERROR("ERROR :: PAGE WAS NOT WRITTEN BEFORE THE SYNC");
+		}
+
+		//a device without space takes no writes, so they cannot be synced
+		File fullFile = File::open("/dev/full");
+		fullFile.allocatePage();
+		bool failed = false;
+		try
+		{
+			syncMgr.flushFile(&fullFile);
+		}
+		catch (const std::system_error &e)
+		{
+			failed = true;
+		}
+		if (!failed)
+		{
+			PRINT_ERROR("ERROR :: FAILED SYNC WAS NOT REPORTED");
+		}
+
+		//without syncing, nothing can fail
+		syncMgr.setSyncPolicy(SyncPolicy::NONE);
+		syncMgr.readPage(&syncFile, syncPageNo, syncPage);
+		syncMgr.unPinPage(&syncFile, syncPageNo, true);
+		syncMgr.flushFile(&syncFile);
+	}
+	File::remove("test.s");
+
+	std::cout << "Test 21 passed" << "\n";
+}
+
+void test22()
+{
+	//Pages written together are written in page order, adjacent ones in one call
+	{
+		File writeFile = File::create("test.w");
+		std::vector<Page> written;
+		std::vector<RecordId> rids;
+		for (int i = 0; i < 5; i++)
+			written.push_back(writeFile.allocatePage());
+		for (int i = 0; i < 5; i++)
+			rids.push_back(written[i].insertRecord("page " + std::to_string(i)));
+
+		File::setWriteHook(recordWrite);
+		writeFile.writePages({&written[2], &written[0], &written[4], &written[1]});
+		if (writeRuns.size() != 2 || writeRuns[0].first != written[0].page_number() || writeRuns[0].second != 3
+				|| writeRuns[1].first != written[4].page_number() || writeRuns[1].second != 1)
+		{
+			PRINT_ERROR("ERROR :: ADJACENT PAGES WERE NOT WRITTEN TOGETHER IN PAGE ORDER");
+		}
+		for (int i : {0, 1, 2, 4})
+		{
+			if (writeFile.readPage(written[i].page_number()).getRecord(rids[i]) != "page " + std::to_string(i))
+			{
+				PRINT_ERROR("ERROR :: PAGE WAS NOT WRITTEN");
+			}
+		}
+
+		//a deleted page fails the whole call before anything is written
+		written[0].updateRecord(rids[0], "changed");
+		writeFile.deletePage(written[1].page_number());
+		writeRuns.clear();
+		bool failed = false;
+		try
+		{
+			writeFile.writePages({&written[0], &written[1]});
+		}
+		catch (const InvalidPageException &e)
+		{
+			failed = true;
+		}
+		if (!failed || !writeRuns.empty()
+				|| writeFile.readPage(written[0].page_number()).getRecord(rids[0]) != "page 0")
+		{
+			PRINT_ERROR("ERROR :: WRITE OF A DELETED PAGE WAS NOT REJECTED AS A WHOLE");
+		}
+
+		//pages which cannot be written in one call go through the stream
+		writesFail = true;
+		written[3].updateRecord(rids[3], "streamed");
+		writeFile.writePages({&written[3], &written[0]});
+		writesFail = false;
+		File::setWriteHook(NULL);
+		if (writeRuns.size() != 2 || writeFile.readPage(written[0].page_number()).getRecord(rids[0]) != "changed"
+				|| writeFile.readPage(written[3].page_number()).getRecord(rids[3]) != "streamed")
+		{
+			PRINT_ERROR("ERROR :: PAGES WERE NOT WRITTEN THROUGH THE STREAM");
+		}
+	}
+	File::remove("test.w");
+
+	std::cout << "Test 22 passed" << "\n";
+}
+
+void test23()
+{
+	//Files keep counters of their own however many files come and go
+	BufMgr manyMgr(num / 10);
+	BufStats &stats = manyMgr.getBufStats();
+	PageId manyPageNo;
+	Page *manyPage;
+	for (std::uint32_t i = 0; i < BufStats::FILE_SLOTS + 6; i++)
+	{
+		const std::string name = "test.many" + std::to_string(i);
+		{
+			File manyFile = File::create(name);
+			manyMgr.allocPage(&manyFile, manyPageNo, manyPage);
+			manyMgr.unPinPage(&manyFile, manyPageNo, false);
+			manyMgr.readPage(&manyFile, manyPageNo, manyPage);
+			manyMgr.unPinPage(&manyFile, manyPageNo, false);
+			BufCounters &manyStats = manyMgr.getFileStats(&manyFile);
+			if (&manyStats == &stats.otherFiles || manyStats.accesses != 2)
+			{
+				PRINT_ERROR("ERROR :: FILE WAS NOT COUNTED SEPARATELY");
+			}
+			manyMgr.dropFile(&manyFile);
+		}
+		File::remove(name);
+	}
+
+	//a file opened again gets a new ID but keeps its counters
+	{
+		File reopened = File::create("test.reopen");
+		manyPageNo = reopened.allocatePage().page_number();
+	}
+	for (std::uint32_t i = 0; i < BufStats::FILE_SLOTS + 6; i++)
+	{
+		File reopened = File::open("test.reopen");
+		manyMgr.readPage(&reopened, manyPageNo, manyPage);
+		manyMgr.unPinPage(&reopened, manyPageNo, false);
+		manyMgr.flushFile(&reopened);
+		if (manyMgr.getFileStats(&reopened).accesses != i + 1)
+		{
+			PRINT_ERROR("ERROR :: REOPENED FILE DID NOT KEEP ITS COUNTERS");
+		}
+	}
+	if (stats.otherFiles.accesses != 0)
+	{
+		PRINT_ERROR("ERROR :: FILES RAN OUT OF SLOTS");
+	}
+	File::remove("test.reopen");
+
+	//a file only takes over a slot once no page of the slot's closed file is in the pool
+	{
+		File held = File::create("test.held");
+		manyMgr.allocPage(&held, manyPageNo, manyPage);
+		manyMgr.unPinPage(&held, manyPageNo, false);
+	}
+	{
+		File other = File::create("test.other");
+		manyMgr.allocPage(&other, manyPageNo, manyPage);
+		manyMgr.unPinPage(&other, manyPageNo, false);
+		if (&manyMgr.getFileStats(&other) != &stats.otherFiles)
+		{
+			PRINT_ERROR("ERROR :: SLOT WAS TAKEN OVER WHILE IN USE");
+		}
+		for (PageId j = 1; j <= num / 10; j++)
+		{
+			manyMgr.readPage(file1ptr, j, manyPage);
+			manyMgr.unPinPage(file1ptr, j, false);
+		}
+		if (&manyMgr.getFileStats(&other) == &stats.otherFiles)
+		{
+			PRINT_ERROR("ERROR :: SLOT WAS NOT TAKEN OVER");
+		}
+		manyMgr.dropFile(&other);
+	}
+	File::remove("test.held");
+	File::remove("test.other");
+
+	std::cout << "Test 23 passed" << "\n";
+}
+
+void test24()
+{
+	//Frames a ring no longer uses must be reclaimed under every policy once the others are pinned
+	const ReplacementPolicy policies[] = {ReplacementPolicy::CLOCK, ReplacementPolicy::LRU_K,
+		ReplacementPolicy::TWO_Q, ReplacementPolicy::ARC, ReplacementPolicy::CLOCK_PRO};
+	for (const ReplacementPolicy policy : policies)
+	{
+		BufMgr policyMgr(num / 10, BufMgr::DEFAULT_PARTITIONS, policy);
+		BufRing ring(policyMgr, 2);
+		for (PageId j = 1; j <= 2; j++)
+		{
+			policyMgr.readPage(file1ptr, j, page, ring);
+			policyMgr.unPinPage(file1ptr, j, false);
+		}
+		for (PageId j = 3; j <= num / 10 + 2; j++)
+		{
+			policyMgr.readPage(file1ptr, j, page);
+			if (page->page_number() != j)
+			{
+				PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH FOR " << Replacer::name(policy));
+			}
+		}
+		try
+		{
+			policyMgr.readPage(file1ptr, num / 10 + 3, page);
+			PRINT_ERROR("ERROR :: No more frames left for allocation. Exception should have been thrown before execution reaches this point.");
+		}
+		catch(const BufferExceededException &e)
+		{
+		}
+		for (PageId j = 3; j <= num / 10 + 2; j++)
+			policyMgr.unPinPage(file1ptr, j, false);
+	}
+
+	std::cout << "Test 24 passed" << "\n";
+}
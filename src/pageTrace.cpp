@@ -0,0 +1,176 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <system_error>
+#include "pageTrace.h"
+
+namespace badgerdb
+{
+
+PageTracer::PageTracer()
+	: active(false), next(CLOSED), chunks(NULL), end(~0ULL)
+{
+}
+
+PageTracer::~PageTracer()
+{
+	stop();
+	if (chunks)
+	{
+		for (std::uint32_t i = 0; i < NUM_CHUNKS; i++)
+			delete[] chunks[i].records;
+		delete[] chunks;
+	}
+}
+
+/**
+* Starts recording into the given file.
+*
+* @param path    Name of the trace file
+* @throws  std::system_error If the file cannot be created
+*/
+void PageTracer::start(const std::string& path)
+{
+	stop();
+	out.open(path, std::ios::binary | std::ios::trunc);
+	if (!out)
+		throw std::system_error(errno, std::generic_category(), "cannot create " + path);
+	out.write(MAGIC, std::strlen(MAGIC));
+
+	// the chunks stay allocated once a trace was taken: a thread which saw
+	// the tracer enabled may still be on its way to next
+	if (!chunks)
+	{
+		chunks = new Chunk[NUM_CHUNKS];
+		for (std::uint32_t i = 0; i < NUM_CHUNKS; i++)
+			chunks[i].records = new std::uint64_t[CHUNK_RECORDS];
+	}
+	for (std::uint32_t i = 0; i < NUM_CHUNKS; i++)
+	{
+		chunks[i].seq.store(i, std::memory_order_relaxed);
+		chunks[i].filled.store(0, std::memory_order_relaxed);
+	}
+	end.store(~0ULL, std::memory_order_relaxed);
+	// publishes the chunks to the threads reserving slots
+	next.store(0, std::memory_order_release);
+	writer = std::thread(&PageTracer::runWriter, this);
+	active.store(true, std::memory_order_release);
+}
+
+/**
+* Stops recording and writes out the events recorded so far.
+*/
+void PageTracer::stop()
+{
+	if (!writer.joinable())
+		return;
+	active.store(false, std::memory_order_relaxed);
+	// slots reserved from now on are past CLOSED and ignored
+	const std::uint64_t reserved = next.fetch_add(CLOSED, std::memory_order_acq_rel);
+	end.store(reserved, std::memory_order_release);
+	wake.notify_all();
+	writer.join();
+	out.close();
+}
+
+/**
+* Records one event.
+*
+* @param op       Kind of event
+* @param file     File ID
+* @param pageNo   Page number
+*/
+void PageTracer::record(const TraceOp op, const FileId file, const PageId pageNo)
+{
+	const std::uint64_t slot = next.fetch_add(1, std::memory_order_acquire);
+	if (slot >= CLOSED)
+		return;
+	const std::uint64_t seq = slot / CHUNK_RECORDS;
+	Chunk &chunk = chunks[seq % NUM_CHUNKS];
+	// the chunk is free once the writer has written its previous contents
+	while (chunk.seq.load(std::memory_order_acquire) != seq)
+	{
+		std::unique_lock<std::mutex> guard(latch);
+		wake.wait_for(guard, std::chrono::milliseconds(1));
+	}
+	const TraceRecord event = {op, file, pageNo};
+	chunk.records[slot % CHUNK_RECORDS] = event.pack();
+	if (chunk.filled.fetch_add(1, std::memory_order_acq_rel) + 1 == CHUNK_RECORDS)
+		wake.notify_all();
+}
+
+/**
+* Main loop of the writer thread: writes the chunks in order, each once all
+* of its slots are filled, and the last one once all reserved slots are.
+*/
+void PageTracer::runWriter()
+{
+	for (std::uint64_t seq = 0; ; seq++)
+	{
+		Chunk &chunk = chunks[seq % NUM_CHUNKS];
+		const std::uint64_t first = seq * CHUNK_RECORDS;
+		std::uint64_t count;
+		while (true)
+		{
+			const std::uint64_t last = end.load(std::memory_order_acquire);
+			count = last >= first + CHUNK_RECORDS ? CHUNK_RECORDS : (last > first ? last - first : 0);
+			if (chunk.filled.load(std::memory_order_acquire) >= count)
+				break;
+			std::unique_lock<std::mutex> guard(latch);
+			wake.wait_for(guard, std::chrono::milliseconds(10));
+		}
+		if (count > 0)
+			out.write(reinterpret_cast<const char*>(chunk.records), count * sizeof(std::uint64_t));
+		if (count < CHUNK_RECORDS)
+			return;
+		chunk.filled.store(0, std::memory_order_relaxed);
+		chunk.seq.store(seq + NUM_CHUNKS, std::memory_order_release);
+		wake.notify_all();
+	}
+}
+
+/**
+* Opens the trace file.
+*
+* @param path    Name of the trace file
+* @throws  std::system_error If the file cannot be opened or is not a trace file
+*/
+TraceReader::TraceReader(const std::string& path)
+	: in(path, std::ios::binary), count(0), pos(0)
+{
+	if (!in)
+		throw std::system_error(errno, std::generic_category(), "cannot open " + path);
+	char magic[8];
+	in.read(magic, sizeof(magic));
+	if (in.gcount() != sizeof(magic) || std::memcmp(magic, PageTracer::MAGIC, sizeof(magic)) != 0)
+		throw std::system_error(EINVAL, std::generic_category(), path + " is not a page trace");
+}
+
+/**
+* Reads the next event.
+*
+* @param record   Used to return the event
+* @return False at the end of the trace
+*/
+bool TraceReader::next(TraceRecord& record)
+{
+	if (pos == count)
+	{
+		in.read(reinterpret_cast<char*>(buffer), sizeof(buffer));
+		count = in.gcount() / sizeof(std::uint64_t);
+		pos = 0;
+		if (count == 0)
+			return false;
+	}
+	record = TraceRecord::unpack(buffer[pos++]);
+	return true;
+}
+
+}
@@ -0,0 +1,225 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+* @brief Kinds of events in a page access trace
+*/
+enum class TraceOp : std::uint8_t
+{
+	READ,				///< page pinned by readPage() or readPages()
+	ALLOC,			///< new page allocated and pinned by allocPage()
+	UNPIN,			///< page unpinned clean
+	DIRTY,			///< page unpinned dirty
+	DISPOSE			///< page disposed
+};
+
+/**
+* @brief One event of a page access trace
+*
+* On disk each event is a single 64-bit word: the op in the top 4 bits, the
+* file ID in the next 28 and the page number in the low 32, in the byte order
+* of the machine which wrote the trace.
+*/
+struct TraceRecord
+{
+  TraceOp op;
+  FileId file;
+  PageId pageNo;
+
+	/**
+	 * Returns the record packed into one word.
+	 */
+  std::uint64_t pack() const
+  {
+		return (std::uint64_t)op << 60 | (std::uint64_t)(file & 0x0FFFFFFF) << 32 | pageNo;
+  }
+
+	/**
+	 * Returns the record packed in word.
+	 */
+  static TraceRecord unpack(const std::uint64_t word)
+  {
+		TraceRecord record;
+		record.op = (TraceOp)(word >> 60);
+		record.file = (FileId)(word >> 32) & 0x0FFFFFFF;
+		record.pageNo = (PageId)word;
+		return record;
+  }
+};
+
+/**
+* @brief Records page accesses into a trace file
+*
+* Threads reserve a slot for each event with one atomic add on a global
+* counter, so the trace keeps the order in which the events happened, and
+* store the packed event in a ring of chunks.  A background thread writes each
+* chunk to the file once all of its slots are filled.  A thread only waits if
+* the writer has fallen a whole ring of chunks behind.
+*
+* A tracer can be started and stopped several times; events recorded while it
+* is stopped are ignored.  Records may be made from any number of threads,
+* but start() and stop() must not run concurrently.
+*/
+class PageTracer
+{
+ private:
+	/**
+   * Number of events in a chunk, and of chunks in the ring
+	 */
+  static constexpr std::uint64_t CHUNK_RECORDS = 1 << 16;
+  static constexpr std::uint32_t NUM_CHUNKS = 8;
+
+	/**
+   * Added to next by stop(), so that slots reserved afterwards are recognised
+	 */
+  static constexpr std::uint64_t CLOSED = 1ULL << 62;
+
+	/**
+   * Chunk of the ring.  seq is the number of the chunk of the trace the
+   * chunk may be filled with next; filled counts the slots stored so far.
+	 */
+  struct Chunk
+  {
+		std::atomic<std::uint64_t> seq;
+		std::atomic<std::uint64_t> filled;
+		std::uint64_t *records;
+  };
+
+	/**
+   * True while the tracer records
+	 */
+  std::atomic<bool> active;
+
+	/**
+   * Number of the next slot of the trace
+	 */
+  std::atomic<std::uint64_t> next;
+
+	/**
+   * Ring of chunks, NULL until the first start()
+	 */
+  Chunk *chunks;
+
+	/**
+   * Slots reserved before stop(); the writer finishes once it has written them
+	 */
+  std::atomic<std::uint64_t> end;
+
+	/**
+   * Trace file
+	 */
+  std::ofstream out;
+
+	/**
+   * Writer thread and what it and waiting threads sleep on
+	 */
+  std::thread writer;
+  std::mutex latch;
+  std::condition_variable wake;
+
+	/**
+   * Main loop of the writer thread
+	 */
+  void runWriter();
+
+ public:
+	/**
+   * First bytes of every trace file
+	 */
+  static constexpr const char* MAGIC = "BDBTRC01";
+
+  PageTracer();
+
+	/**
+   * Stops the tracer if it is running.
+	 */
+  ~PageTracer();
+
+  PageTracer(const PageTracer &) = delete;
+  PageTracer &operator=(const PageTracer &) = delete;
+
+	/**
+	 * Starts recording into the given file, which is truncated.
+	 *
+	 * @param path   	Name of the trace file
+   * @throws  std::system_error If the file cannot be created
+	 */
+  void start(const std::string& path);
+
+	/**
+	 * Stops recording, writes out the events recorded so far and closes the
+	 * file.  Does nothing if the tracer is not running.
+	 */
+  void stop();
+
+	/**
+	 * Returns true while the tracer records.  Meant to be checked before
+	 * record(), so that a stopped tracer costs a single load.
+	 */
+  bool enabled() const { return active.load(std::memory_order_relaxed); }
+
+	/**
+	 * Records one event.
+	 *
+	 * @param op   			Kind of event
+	 * @param file   		File ID
+	 * @param pageNo   	Page number
+	 */
+  void record(const TraceOp op, const FileId file, const PageId pageNo);
+};
+
+/**
+* @brief Reads the events of a trace file written by PageTracer
+*/
+class TraceReader
+{
+ private:
+	/**
+   * Trace file
+	 */
+  std::ifstream in;
+
+	/**
+   * Events read from the file and not yet returned
+	 */
+  std::uint64_t buffer[4096];
+  std::uint32_t count;
+  std::uint32_t pos;
+
+ public:
+	/**
+	 * Opens the trace file.
+	 *
+	 * @param path   	Name of the trace file
+   * @throws  std::system_error If the file cannot be opened or is not a trace file
+	 */
+  explicit TraceReader(const std::string& path);
+
+	/**
+	 * Reads the next event.
+	 *
+	 * @param record   	Used to return the event
+	 * @return False at the end of the trace
+	 */
+  bool next(TraceRecord& record);
+};
+
+}
@@ -0,0 +1,951 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "replacer.h"
+
+namespace badgerdb {
+
+/**
+* Offers the entries of list to claim, oldest first.
+*
+* @return True if claim accepted one; it is returned via frame
+*/
+static bool claimOldest(const IndexList &list, FrameId &frame, const std::function<bool(FrameId)> &claim)
+{
+	for (std::uint32_t i = list.back(); i != list.end(); i = list.older(i))
+	{
+		if (claim(i))
+		{
+			frame = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+* Appends the entries of list to frames, oldest first, as long as there is room.
+*/
+static void listOldest(const IndexList &list, FrameId *frames, const std::uint32_t max, std::uint32_t &count)
+{
+	for (std::uint32_t i = list.back(); i != list.end() && count < max; i = list.older(i))
+		frames[count++] = i;
+}
+
+Replacer* Replacer::create(const ReplacementPolicy policy, const std::uint32_t numFrames,
+                           const std::uint32_t maxFrames)
+{
+	const std::uint32_t capacity = maxFrames > numFrames ? maxFrames : numFrames;
+	switch (policy)
+	{
+		case ReplacementPolicy::LRU_K:
+			return new LruKReplacer(numFrames, capacity);
+		case ReplacementPolicy::TWO_Q:
+			return new TwoQReplacer(numFrames, capacity);
+		case ReplacementPolicy::ARC:
+			return new ArcReplacer(numFrames, capacity);
+		case ReplacementPolicy::CLOCK_PRO:
+			return new ClockProReplacer(numFrames, capacity);
+		case ReplacementPolicy::CLOCK:
+		default:
+			return new ClockReplacer(numFrames, capacity);
+	}
+}
+
+const char* Replacer::name(const ReplacementPolicy policy)
+{
+	switch (policy)
+	{
+		case ReplacementPolicy::LRU_K:
+			return "LRU-2";
+		case ReplacementPolicy::TWO_Q:
+			return "2Q";
+		case ReplacementPolicy::ARC:
+			return "ARC";
+		case ReplacementPolicy::CLOCK_PRO:
+			return "CLOCK-Pro";
+		case ReplacementPolicy::CLOCK:
+		default:
+			return "CLOCK";
+	}
+}
+
+/**
+* IndexList
+*/
+
+IndexList::IndexList(const std::uint32_t size)
+	: n(size), count(0)
+{
+	prev = new std::uint32_t[size + 1];
+	next = new std::uint32_t[size + 1];
+	prev[n] = next[n] = n;
+}
+
+IndexList::~IndexList()
+{
+	delete[] prev;
+	delete[] next;
+}
+
+void IndexList::pushFront(const std::uint32_t i)
+{
+	prev[i] = n;
+	next[i] = next[n];
+	prev[next[n]] = i;
+	next[n] = i;
+	count++;
+}
+
+void IndexList::remove(const std::uint32_t i)
+{
+	next[prev[i]] = next[i];
+	prev[next[i]] = prev[i];
+	count--;
+}
+
+/**
+* GhostList
+*/
+
+GhostList::GhostList(const std::uint32_t cap)
+	: capacity(cap), limit(cap), order(cap), index(cap), numFree(0)
+{
+	keys = new PageKey[cap];
+	freeSlots = new std::uint32_t[cap];
+	for (std::uint32_t i = cap; i > 0; i--)
+		freeSlots[numFree++] = i - 1;
+}
+
+GhostList::~GhostList()
+{
+	delete[] keys;
+	delete[] freeSlots;
+}
+
+void GhostList::resize(const std::uint32_t newLimit)
+{
+	limit = newLimit < capacity ? newLimit : capacity;
+	while (order.size() > limit)
+		popOldest();
+}
+
+std::uint32_t GhostList::find(const PageKey key) const
+{
+	FrameId slot;
+	return index.tryLookup(key, slot) ? slot : NONE;
+}
+
+std::uint32_t GhostList::push(const PageKey key)
+{
+	if (limit == 0)
+		return NONE;
+	const std::uint32_t old = find(key);
+	if (old != NONE)
+		erase(old);
+	if (order.size() >= limit)
+		popOldest();
+	const std::uint32_t slot = freeSlots[--numFree];
+	keys[slot] = key;
+	index.tryInsert(key, slot);
+	order.pushFront(slot);
+	return slot;
+}
+
+void GhostList::erase(const std::uint32_t slot)
+{
+	index.tryRemove(keys[slot]);
+	order.remove(slot);
+	freeSlots[numFree++] = slot;
+}
+
+void GhostList::popOldest()
+{
+	if (order.size() > 0)
+		erase(order.back());
+}
+
+/**
+* ClockReplacer
+*/
+
+ClockReplacer::ClockReplacer(const std::uint32_t frames, const std::uint32_t capacity)
+	: numFrames(frames), clockHand(frames > 0 ? frames - 1 : 0)
+{
+	refbit = new std::atomic<bool>[capacity];
+	for (FrameId i = 0; i < capacity; i++)
+		refbit[i] = false;
+}
+
+ClockReplacer::~ClockReplacer()
+{
+	delete[] refbit;
+}
+
+FrameId ClockReplacer::advanceClock()
+{
+	FrameId hand = clockHand.load(std::memory_order_relaxed);
+	const std::uint32_t frames = numFrames.load(std::memory_order_relaxed);
+	FrameId next;
+	do
+	{
+		next = (hand + 1) % frames;
+	} while (!clockHand.compare_exchange_weak(hand, next, std::memory_order_relaxed));
+	return next;
+}
+
+void ClockReplacer::access(const FrameId frame, const PageKey)
+{
+	// only touch the cache line if the bit is not set yet
+	if (!refbit[frame].load(std::memory_order_relaxed))
+		refbit[frame].store(true, std::memory_order_relaxed);
+}
+
+void ClockReplacer::load(const FrameId frame, const PageKey)
+{
+	refbit[frame].store(true, std::memory_order_relaxed);
+}
+
+void ClockReplacer::evict(const FrameId frame)
+{
+	refbit[frame].store(false, std::memory_order_relaxed);
+}
+
+void ClockReplacer::remove(const FrameId frame)
+{
+	refbit[frame].store(false, std::memory_order_relaxed);
+}
+
+bool ClockReplacer::victim(FrameId &frame, const std::function<bool(FrameId)> &claim)
+{
+	// two sweeps find a victim unless other threads keep pinning the frames
+	for (std::uint32_t i = 0; i < 2 * numFrames; i++)
+	{
+		const FrameId hand = advanceClock();
+		if (refbit[hand].load(std::memory_order_relaxed))
+		{
+			refbit[hand].store(false, std::memory_order_relaxed);
+			continue;
+		}
+		if (claim(hand))
+		{
+			frame = hand;
+			return true;
+		}
+	}
+	return false;
+}
+
+std::uint32_t ClockReplacer::upcoming(FrameId *frames, const std::uint32_t max)
+{
+	// the first sweep takes unreferenced frames, the second one the others
+	const FrameId hand = clockHand.load(std::memory_order_relaxed);
+	const std::uint32_t size = numFrames.load(std::memory_order_relaxed);
+	std::uint32_t count = 0;
+	for (int referenced = 0; referenced < 2; referenced++)
+	{
+		for (std::uint32_t i = 1; i <= size && count < max; i++)
+		{
+			const FrameId frame = (hand + i) % size;
+			if (refbit[frame].load(std::memory_order_relaxed) == (referenced == 1))
+				frames[count++] = frame;
+		}
+	}
+	return count;
+}
+
+void ClockReplacer::resize(const std::uint32_t frames)
+{
+	// the removed frames are unknown to the policy, so their bits are clear
+	numFrames.store(frames, std::memory_order_relaxed);
+}
+
+/**
+* LruKReplacer
+*/
+
+LruKReplacer::LruKReplacer(const std::uint32_t frames, const std::uint32_t capacity)
+	: numFrames(frames), now(0), ghosts(capacity)
+{
+	keys = new PageKey[capacity];
+	history = new std::uint64_t[capacity * K];
+	ghostHistory = new std::uint64_t[capacity * K];
+	for (FrameId i = 0; i < capacity; i++)
+		keys[i] = 0;
+	ghosts.resize(frames);
+}
+
+LruKReplacer::~LruKReplacer()
+{
+	delete[] keys;
+	delete[] history;
+	delete[] ghostHistory;
+}
+
+std::tuple<std::uint64_t, std::uint64_t, FrameId> LruKReplacer::orderKey(const FrameId frame) const
+{
+	// pages with fewer than K references have a K-th reference of 0
+	return std::make_tuple(history[frame * K + K - 1], history[frame * K], frame);
+}
+
+void LruKReplacer::reference(const FrameId frame)
+{
+	std::uint64_t *times = &history[frame * K];
+	for (int i = K - 1; i > 0; i--)
+		times[i] = times[i - 1];
+	times[0] = ++now;
+}
+
+void LruKReplacer::access(const FrameId frame, const PageKey key)
+{
+	std::lock_guard<std::mutex> guard(latch);
+	if (keys[frame] != key)
+		return;
+	order.erase(orderKey(frame));
+	reference(frame);
+	order.insert(orderKey(frame));
+}
+
+void LruKReplacer::load(const FrameId frame, const PageKey key)
+{
+	std::lock_guard<std::mutex> guard(latch);
+	if (keys[frame] != 0)
+		order.erase(orderKey(frame));
+	keys[frame] = key;
+
+	// a page evicted not long ago keeps its reference times
+	const std::uint32_t slot = ghosts.find(key);
+	for (int i = 0; i < K; i++)
+		history[frame * K + i] = slot != GhostList::NONE ? ghostHistory[slot * K + i] : 0;
+	if (slot != GhostList::NONE)
+		ghosts.erase(slot);
+
+	reference(frame);
+	order.insert(orderKey(frame));
+}
+
+void LruKReplacer::evict(const FrameId frame)
+{
+	std::lock_guard<std::mutex> guard(latch);
+	if (keys[frame] == 0)
+		return;
+	order.erase(orderKey(frame));
+	const std::uint32_t slot = ghosts.push(keys[frame]);
+	if (slot != GhostList::NONE)
+	{
+		for (int i = 0; i < K; i++)
+			ghostHistory[slot * K + i] = history[frame * K + i];
+	}
+	keys[frame] = 0;
+}
+
+void LruKReplacer::remove(const FrameId frame)
+{
+	std::lock_guard<std::mutex> guard(latch);
+	if (keys[frame] == 0)
+		return;
+	order.erase(orderKey(frame));
+	keys[frame] = 0;
+}
+
+bool LruKReplacer::victim(FrameId &frame, const std::function<bool(FrameId)> &claim)
+{
+	std::lock_guard<std::mutex> guard(latch);
+	for (const std::tuple<std::uint64_t, std::uint64_t, FrameId> &entry : order)
+	{
+		if (claim(std::get<2>(entry)))
+		{
+			frame = std::get<2>(entry);
+			return true;
+		}
+	}
+	return false;
+}
+
+std::uint32_t LruKReplacer::upcoming(FrameId *frames, const std::uint32_t max)
+{
+	std::lock_guard<std::mutex> guard(latch);
+	std::uint32_t count = 0;
+	for (const std::tuple<std::uint64_t, std::uint64_t, FrameId> &entry : order)
+	{
+		if (count == max)
+			break;
+		frames[count++] = std::get<2>(entry);
+	}
+	return count;
+}
+
+void LruKReplacer::resize(const std::uint32_t frames)
+{
+	std::lock_guard<std::mutex> guard(latch);
+	numFrames = frames;
+	ghosts.resize(frames);
+}
+
+/**
+* TwoQReplacer
+*/
+
+TwoQReplacer::TwoQReplacer(const std::uint32_t frames, const std::uint32_t capacity)
+	: numFrames(frames), maxA1in(frames / 4 > 0 ? frames / 4 : 1),
+		a1in(capacity), am(capacity), a1out(capacity / 2)
+{
+	keys = new PageKey[capacity];
+	queue = new unsigned char[capacity];
+	for (FrameId i = 0; i < capacity; i++)
+	{
+		keys[i] = 0;
+		queue[i] = NO_QUEUE;
+	}
+	a1out.resize(frames / 2);
+}
+
+TwoQReplacer::~TwoQReplacer()
+{
+	delete[] keys;
+	delete[] queue;
+}
+
+void TwoQReplacer::unlink(const FrameId frame)
+{
+	if (queue[frame] == A1IN)
+		a1in.remove(frame);
+	else if (queue[frame] == AM)
+		am.remove(frame);
+	queue[frame] = NO_QUEUE;
+	keys[frame] = 0;
+}
+
+void TwoQReplacer::access(const FrameId frame, const PageKey key)
+{
+	std::lock_guard<std::mutex> guard(latch);
+	// hits on A1in do not count; they are usually correlated with the first one
+	if (keys[frame] != key || queue[frame] != AM)
+		return;
+	am.remove(frame);
+	am.pushFront(frame);
+}
+
+void TwoQReplacer::load(const FrameId frame, const PageKey key)
+{
+	std::lock_guard<std::mutex> guard(latch);
+	unlink(frame);
+	keys[frame] = key;
+	const std::uint32_t slot = a1out.find(key);
+	if (slot != GhostList::NONE)
+	{
+		a1out.erase(slot);
+		am.pushFront(frame);
+		queue[frame] = AM;
+	}
+	else
+	{
+		a1in.pushFront(frame);
+		queue[frame] = A1IN;
+	}
+}
+
+void TwoQReplacer::evict(const FrameId frame)
+{
+	std::lock_guard<std::mutex> guard(latch);
+	if (queue[frame] == A1IN)
+		a1out.push(keys[frame]);
+	unlink(frame);
+}
+
+void TwoQReplacer::remove(const FrameId frame)
+{
+	std::lock_guard<std::mutex> guard(latch);
+	unlink(frame);
+}
+
+bool TwoQReplacer::victim(FrameId &frame, const std::function<bool(FrameId)> &claim)
+{
+	std::lock_guard<std::mutex> guard(latch);
+	if (a1in.size() > maxA1in)
+		return claimOldest(a1in, frame, claim) || claimOldest(am, frame, claim);
+	return claimOldest(am, frame, claim) || claimOldest(a1in, frame, claim);
+}
+
+std::uint32_t TwoQReplacer::upcoming(FrameId *frames, const std::uint32_t max)
+{
+	std::lock_guard<std::mutex> guard(latch);
+	std::uint32_t count = 0;
+	const bool a1inFirst = a1in.size() > maxA1in;
+	listOldest(a1inFirst ? a1in : am, frames, max, count);
+	listOldest(a1inFirst ? am : a1in, frames, max, count);
+	return count;
+}
+
+void TwoQReplacer::resize(const std::uint32_t frames)
+{
+	std::lock_guard<std::mutex> guard(latch);
+	numFrames = frames;
+	maxA1in = frames / 4 > 0 ? frames / 4 : 1;
+	a1out.resize(frames / 2);
+}
+
+/**
+* ArcReplacer
+*/
+
+ArcReplacer::ArcReplacer(const std::uint32_t frames, const std::uint32_t capacity)
+	: numFrames(frames), p(0), t1(capacity), t2(capacity), b1(capacity), b2(capacity)
+{
+	keys = new PageKey[capacity];
+	queue = new unsigned char[capacity];
+	for (FrameId i = 0; i < capacity; i++)
+	{
+		keys[i] = 0;
+		queue[i] = NO_QUEUE;
+	}
+	b1.resize(frames);
+	b2.resize(frames);
+}
+
+ArcReplacer::~ArcReplacer()
+{
+	delete[] keys;
+	delete[] queue;
+}
+
+void ArcReplacer::unlink(const FrameId frame)
+{
+	if (queue[frame] == T1)
+		t1.remove(frame);
+	else if (queue[frame] == T2)
+		t2.remove(frame);
+	queue[frame] = NO_QUEUE;
+	keys[frame] = 0;
+}
+
+void ArcReplacer::access(const FrameId frame, const PageKey key)
+{
+	std::lock_guard<std::mutex> guard(latch);
+	if (keys[frame] != key || queue[frame] == NO_QUEUE)
+		return;
+	if (queue[frame] == T1)
+		t1.remove(frame);
+	else
+		t2.remove(frame);
+	t2.pushFront(frame);
+	queue[frame] = T2;
+}
+
+void ArcReplacer::load(const FrameId frame, const PageKey key)
+{
+	std::lock_guard<std::mutex> guard(latch);
+	unlink(frame);
+	keys[frame] = key;
+
+	const std::uint32_t slot1 = b1.find(key);
+	const std::uint32_t slot2 = slot1 == GhostList::NONE ? b2.find(key) : GhostList::NONE;
+	if (slot1 != GhostList::NONE)
+	{
+		// T1 was too small to keep this page: grow its target
+		const std::uint32_t delta = b2.size() > b1.size() ? b2.size() / b1.size() : 1;
+		p = p + delta < numFrames ? p + delta : numFrames;
+		b1.erase(slot1);
+	}
+	else if (slot2 != GhostList::NONE)
+	{
+		// T2 was too small to keep this page: shrink the target of T1
+		const std::uint32_t delta = b1.size() > b2.size() ? b1.size() / b2.size() : 1;
+		p = p > delta ? p - delta : 0;
+		b2.erase(slot2);
+	}
+	else
+	{
+		// a new page; keep T1 + B1 within c pages and all four lists within 2c
+		if (t1.size() + b1.size() >= numFrames)
+			b1.popOldest();
+		else if (t1.size() + t2.size() + b1.size() + b2.size() >= 2 * numFrames)
+			b2.popOldest();
+		t1.pushFront(frame);
+		queue[frame] = T1;
+		return;
+	}
+	t2.pushFront(frame);
+	queue[frame] = T2;
+}
+
+void ArcReplacer::evict(const FrameId frame)
+{
+	std::lock_guard<std::mutex> guard(latch);
+	if (queue[frame] == T1)
+		b1.push(keys[frame]);
+	else if (queue[frame] == T2)
+		b2.push(keys[frame]);
+	unlink(frame);
+}
+
+void ArcReplacer::remove(const FrameId frame)
+{
+	std::lock_guard<std::mutex> guard(latch);
+	unlink(frame);
+}
+
+bool ArcReplacer::victim(FrameId &frame, const std::function<bool(FrameId)> &claim)
+{
+	std::lock_guard<std::mutex> guard(latch);
+	if (t1.size() > p)
+		return claimOldest(t1, frame, claim) || claimOldest(t2, frame, claim);
+	return claimOldest(t2, frame, claim) || claimOldest(t1, frame, claim);
+}
+
+std::uint32_t ArcReplacer::upcoming(FrameId *frames, const std::uint32_t max)
+{
+	std::lock_guard<std::mutex> guard(latch);
+	std::uint32_t count = 0;
+	const bool t1First = t1.size() > p;
+	listOldest(t1First ? t1 : t2, frames, max, count);
+	listOldest(t1First ? t2 : t1, frames, max, count);
+	return count;
+}
+
+void ArcReplacer::resize(const std::uint32_t frames)
+{
+	std::lock_guard<std::mutex> guard(latch);
+	// scale the target of T1 with the pool
+	if (numFrames > 0)
+		p = (std::uint32_t)((std::uint64_t)p * frames / numFrames);
+	numFrames = frames;
+	b1.resize(frames);
+	b2.resize(frames);
+}
+
+/**
+* ClockProReplacer
+*/
+
+ClockProReplacer::ClockProReplacer(const std::uint32_t frames, const std::uint32_t capacity)
+	: numFrames(frames), numNodes(2 * capacity), index(2 * capacity),
+		handHot(NONE), handCold(NONE), handTest(NONE),
+		numHot(0), numCold(0), numTest(0), coldTarget(frames / 2 > 0 ? frames / 2 : 1)
+{
+	nodeKey = new PageKey[numNodes];
+	nodeFrame = new FrameId[numNodes];
+	flags = new unsigned char[numNodes];
+	prev = new std::uint32_t[numNodes];
+	next = new std::uint32_t[numNodes];
+	freeNodes = new std::uint32_t[numNodes];
+	numFree = 0;
+	for (std::uint32_t i = numNodes; i > 0; i--)
+		freeNodes[numFree++] = i - 1;
+
+	frameNode = new std::uint32_t[capacity];
+	for (FrameId i = 0; i < capacity; i++)
+		frameNode[i] = NONE;
+}
+
+ClockProReplacer::~ClockProReplacer()
+{
+	delete[] nodeKey;
+	delete[] nodeFrame;
+	delete[] flags;
+	delete[] prev;
+	delete[] next;
+	delete[] freeNodes;
+	delete[] frameNode;
+}
+
+/**
+* Puts node at the head of the clock, the position the hot hand reaches last.
+*/
+void ClockProReplacer::link(const std::uint32_t node)
+{
+	if (handHot == NONE)
+	{
+		prev[node] = next[node] = node;
+		handHot = handCold = handTest = node;
+		return;
+	}
+	const std::uint32_t tail = prev[handHot];
+	next[tail] = node;
+	prev[node] = tail;
+	next[node] = handHot;
+	prev[handHot] = node;
+}
+
+/**
+* Takes node off the clock, moving any hand pointing at it to the next node.
+*/
+void ClockProReplacer::unlink(const std::uint32_t node)
+{
+	if (next[node] == node)
+	{
+		handHot = handCold = handTest = NONE;
+		return;
+	}
+	if (handHot == node)
+		handHot = next[node];
+	if (handCold == node)
+		handCold = next[node];
+	if (handTest == node)
+		handTest = next[node];
+	next[prev[node]] = next[node];
+	prev[next[node]] = prev[node];
+}
+
+/**
+* Forgets the page of node altogether.
+*/
+void ClockProReplacer::drop(const std::uint32_t node)
+{
+	unlink(node);
+	index.tryRemove(nodeKey[node]);
+	if (nodeFrame[node] == NONE)
+		numTest--;
+	else
+	{
+		frameNode[nodeFrame[node]] = NONE;
+		if (flags[node] & HOT)
+			numHot--;
+		else
+			numCold--;
+	}
+	freeNodes[numFree++] = node;
+}
+
+/**
+* Ends the test period of a cold page.  A non-resident page is forgotten, and
+* since it was not requested again, fewer cold pages would have done.
+*/
+void ClockProReplacer::endTest(const std::uint32_t node)
+{
+	flags[node] &= ~TEST;
+	if (nodeFrame[node] == NONE)
+	{
+		drop(node);
+		if (coldTarget > 1)
+			coldTarget--;
+	}
+}
+
+/**
+* Runs the hot hand until it has demoted one hot page.
+*
+* @return False if there was no hot page to demote
+*/
+bool ClockProReplacer::runHandHot()
+{
+	for (std::uint32_t steps = 0; handHot != NONE && numHot > 0 && steps <= 2 * numNodes; steps++)
+	{
+		const std::uint32_t node = handHot;
+		handHot = next[node];
+		if (flags[node] & HOT)
+		{
+			if (flags[node] & REF)
+			{
+				flags[node] &= ~REF;
+				continue;
+			}
+			flags[node] &= ~HOT;
+			numHot--;
+			numCold++;
+			return true;
+		}
+		if (flags[node] & TEST)
+			endTest(node);
+	}
+	return false;
+}
+
+/**
+* Runs the test hand until it has forgotten one non-resident page.
+*
+* @return False if there was no non-resident page to forget
+*/
+bool ClockProReplacer::runHandTest()
+{
+	for (std::uint32_t steps = 0; handTest != NONE && numTest > 0 && steps <= 2 * numNodes; steps++)
+	{
+		const std::uint32_t node = handTest;
+		handTest = next[node];
+		if ((flags[node] & (HOT | TEST)) == TEST)
+		{
+			const bool resident = nodeFrame[node] != NONE;
+			endTest(node);
+			if (!resident)
+				return true;
+		}
+	}
+	return false;
+}
+
+void ClockProReplacer::access(const FrameId frame, const PageKey key)
+{
+	std::lock_guard<std::mutex> guard(latch);
+	const std::uint32_t node = frameNode[frame];
+	if (node != NONE && nodeKey[node] == key)
+		flags[node] |= REF;
+}
+
+void ClockProReplacer::load(const FrameId frame, const PageKey key)
+{
+	std::lock_guard<std::mutex> guard(latch);
+	if (frameNode[frame] != NONE)
+		drop(frameNode[frame]);
+
+	FrameId found;
+	std::uint32_t node = NONE;
+	if (index.tryLookup(key, found))
+	{
+		node = found;
+		if (nodeFrame[node] != NONE)
+		{
+			drop(node);		// cannot be resident twice, start afresh
+			node = NONE;
+		}
+	}
+
+	if (node != NONE)
+	{
+		// requested again during its test period: it comes back hot, and
+		// more cold pages would have kept it resident
+		if (coldTarget + 1 < numFrames)
+			coldTarget++;
+		unlink(node);
+		numTest--;
+		flags[node] = HOT;
+		nodeFrame[node] = frame;
+		link(node);
+		numHot++;
+	}
+	else
+	{
+		if (numFree == 0)
+			runHandTest();
+		node = freeNodes[--numFree];
+		nodeKey[node] = key;
+		nodeFrame[node] = frame;
+		flags[node] = TEST;
+		index.tryInsert(key, node);
+		link(node);
+		numCold++;
+	}
+	frameNode[frame] = node;
+
+	while (numHot + coldTarget > numFrames && runHandHot())
+		;
+}
+
+void ClockProReplacer::evict(const FrameId frame)
+{
+	std::lock_guard<std::mutex> guard(latch);
+	const std::uint32_t node = frameNode[frame];
+	if (node == NONE)
+		return;
+	if ((flags[node] & (HOT | TEST)) != TEST)
+	{
+		drop(node);
+		return;
+	}
+	// a cold page in its test period is remembered until the period ends
+	frameNode[frame] = NONE;
+	nodeFrame[node] = NONE;
+	flags[node] &= ~REF;
+	numCold--;
+	numTest++;
+	while (numTest > numFrames && runHandTest())
+		;
+}
+
+void ClockProReplacer::remove(const FrameId frame)
+{
+	std::lock_guard<std::mutex> guard(latch);
+	if (frameNode[frame] != NONE)
+		drop(frameNode[frame]);
+}
+
+bool ClockProReplacer::victim(FrameId &frame, const std::function<bool(FrameId)> &claim)
+{
+	std::lock_guard<std::mutex> guard(latch);
+	std::uint32_t lap = 0;
+	for (std::uint32_t steps = 0; steps <= 4 * numNodes; steps++)
+	{
+		// without unpinned cold pages nothing can be evicted: demote a hot one
+		if (numCold == 0 || lap > numHot + numCold + numTest)
+		{
+			runHandHot();
+			lap = 0;
+		}
+		if (handCold == NONE)
+			return false;
+		const std::uint32_t node = handCold;
+		handCold = next[node];
+		lap++;
+		if ((flags[node] & HOT) || nodeFrame[node] == NONE)
+			continue;
+
+		if (flags[node] & REF)
+		{
+			flags[node] &= ~REF;
+			if (flags[node] & TEST)
+			{
+				// requested again during its test period: promote it
+				flags[node] = HOT;
+				numCold--;
+				numHot++;
+				if (coldTarget + 1 < numFrames)
+					coldTarget++;
+				while (numHot + coldTarget > numFrames && runHandHot())
+					;
+			}
+			else
+				flags[node] |= TEST;
+			unlink(node);
+			link(node);
+			continue;
+		}
+
+		if (claim(nodeFrame[node]))
+		{
+			frame = nodeFrame[node];
+			return true;
+		}
+	}
+	return false;
+}
+
+std::uint32_t ClockProReplacer::upcoming(FrameId *frames, const std::uint32_t max)
+{
+	std::lock_guard<std::mutex> guard(latch);
+	std::uint32_t count = 0;
+	if (handCold == NONE)
+		return 0;
+	// the cold hand evicts unreferenced cold pages first, referenced ones
+	// only after they have been passed over once
+	for (int referenced = 0; referenced < 2; referenced++)
+	{
+		std::uint32_t node = handCold;
+		do
+		{
+			if (count == max)
+				return count;
+			if ((flags[node] & HOT) == 0 && nodeFrame[node] != NONE && ((flags[node] & REF) != 0) == (referenced == 1))
+				frames[count++] = nodeFrame[node];
+			node = next[node];
+		} while (node != handCold);
+	}
+	return count;
+}
+
+void ClockProReplacer::resize(const std::uint32_t frames)
+{
+	std::lock_guard<std::mutex> guard(latch);
+	numFrames = frames;
+	if (coldTarget + 1 > numFrames)
+		coldTarget = numFrames > 1 ? numFrames - 1 : 1;
+	// demote hot pages and forget test pages beyond the new size
+	while (numHot + coldTarget > numFrames && runHandHot())
+		;
+	while (numTest > numFrames && runHandTest())
+		;
+}
+
+}
@@ -0,0 +1,510 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <tuple>
+
+#include "types.h"
+#include "bufHashTbl.h"
+
+namespace badgerdb {
+
+/**
+* @brief Page replacement policies understood by BufMgr
+*/
+enum class ReplacementPolicy
+{
+	CLOCK,			///< single reference bit CLOCK, the default
+	LRU_K,			///< LRU-2 with retained history of evicted pages
+	TWO_Q,			///< full 2Q with A1in, A1out and Am queues
+	ARC,				///< Adaptive Replacement Cache
+	CLOCK_PRO		///< CLOCK-Pro with hot, cold and non-resident test pages
+};
+
+/**
+* @brief Interface between BufMgr and a page replacement policy
+*
+* BufMgr tells the policy which page every frame holds and when it is used,
+* and asks it for a victim when it runs out of free frames.  Frames which are
+* free or being claimed by BufMgr are unknown to the policy.
+*
+* All methods may be called from several threads at once; each policy does
+* its own latching.  BufMgr never holds any of its latches while calling a
+* policy, and the policy calls back into BufMgr only through the claim
+* function passed to victim().
+*/
+class Replacer
+{
+ public:
+	/**
+	 * Creates a policy of the given kind for a buffer pool of numFrames frames,
+	 * which may later be resized to up to maxFrames frames.
+	 *
+	 * @param policy   	Kind of policy
+	 * @param numFrames Number of frames in the buffer pool
+	 * @param maxFrames Largest number of frames the pool may grow to; numFrames if smaller
+	 * @return Newly allocated policy, owned by the caller
+	 */
+  static Replacer* create(const ReplacementPolicy policy, const std::uint32_t numFrames,
+                          const std::uint32_t maxFrames = 0);
+
+	/**
+	 * Returns a short printable name of the given kind of policy.
+	 */
+  static const char* name(const ReplacementPolicy policy);
+
+  virtual ~Replacer() {}
+
+	/**
+	 * The page with the given key, held in frame, was requested again.  The
+	 * call may arrive after the page has already left the frame; policies
+	 * ignore it then.
+	 *
+	 * @param frame   	Frame holding the page
+	 * @param key   		Page key of the page
+	 */
+  virtual void access(const FrameId frame, const PageKey key) = 0;
+
+	/**
+	 * The page with the given key was brought into frame after a miss.
+	 *
+	 * @param frame   	Frame now holding the page
+	 * @param key   		Page key of the page
+	 */
+  virtual void load(const FrameId frame, const PageKey key) = 0;
+
+	/**
+	 * The page held in frame was written back if necessary and taken out of
+	 * the pool to make room.  Policies with a history remember it.
+	 *
+	 * @param frame   	Frame which held the page
+	 */
+  virtual void evict(const FrameId frame) = 0;
+
+	/**
+	 * The frame was freed for any other reason, for example because its page
+	 * was disposed.  Does nothing if the policy does not know the frame.
+	 *
+	 * @param frame   	Frame which held the page
+	 */
+  virtual void remove(const FrameId frame) = 0;
+
+	/**
+	 * Offers frames to claim in the order the policy prefers to replace them,
+	 * until claim accepts one.  claim returns false for frames which are
+	 * pinned; the page of an accepted frame stays known to the policy until
+	 * BufMgr calls evict() for it.
+	 *
+	 * @param frame   	Frame reference, the accepted frame is returned via this variable
+	 * @param claim   	Function which tries to take a frame for eviction
+	 * @return False if no frame was accepted
+	 */
+  virtual bool victim(FrameId &frame, const std::function<bool(FrameId)> &claim) = 0;
+
+	/**
+	 * Lists the frames victim() would offer next, in that order, without
+	 * changing the state of the policy.  Used to write dirty pages back before
+	 * they are evicted.
+	 *
+	 * @param frames   	Array receiving the frames
+	 * @param max   		Size of the array
+	 * @return Number of frames listed
+	 */
+  virtual std::uint32_t upcoming(FrameId *frames, const std::uint32_t max) = 0;
+
+	/**
+	 * The buffer pool now has the given number of frames, at most the
+	 * maxFrames the policy was created for.  Frames at or above the new size
+	 * have been removed or evicted before the pool shrinks; policies scale
+	 * their targets and histories to the new size.
+	 *
+	 * @param frames   	New number of frames in the buffer pool
+	 */
+  virtual void resize(const std::uint32_t frames) = 0;
+};
+
+
+/**
+* @brief Doubly linked list of small integers, used for recency and FIFO queues
+*
+* Entries are the numbers 0 to size-1, each on at most one list.  The links
+* live in two arrays allocated by the constructor, so no operation allocates.
+* Entries are pushed at the front; the back is the oldest entry.
+*/
+class IndexList
+{
+ private:
+	/**
+	 * Links of every entry; index n is the sentinel
+	 */
+  std::uint32_t *prev;
+  std::uint32_t *next;
+
+	/**
+	 * Number of possible entries, also the index of the sentinel
+	 */
+  std::uint32_t n;
+
+	/**
+	 * Number of entries on the list
+	 */
+  std::uint32_t count;
+
+ public:
+  IndexList(const std::uint32_t size);
+  ~IndexList();
+
+	/**
+	 * Returns the index of the sentinel, which back() and older() return once
+	 * the list is exhausted.
+	 */
+  std::uint32_t end() const { return n; }
+  std::uint32_t size() const { return count; }
+  std::uint32_t back() const { return prev[n]; }
+
+	/**
+	 * Returns the entry pushed just before the given one.
+	 */
+  std::uint32_t older(const std::uint32_t i) const { return prev[i]; }
+
+  void pushFront(const std::uint32_t i);
+  void remove(const std::uint32_t i);
+};
+
+
+/**
+* @brief Bounded FIFO of page keys of pages which are no longer resident
+*
+* Used for the history ("ghost") queues of the policies.  Each key occupies
+* one of capacity slots, which policies may use to attach data to the key.
+* Pushing onto a full list drops the oldest key.
+*/
+class GhostList
+{
+ private:
+  std::uint32_t capacity;
+  std::uint32_t limit;
+  IndexList order;
+  PageKey *keys;
+  BufHashTbl index;
+  std::uint32_t *freeSlots;
+  std::uint32_t numFree;
+
+ public:
+	/**
+	 * Slot number returned for keys which are not on the list
+	 */
+  static const std::uint32_t NONE = ~0u;
+
+  GhostList(const std::uint32_t cap);
+  ~GhostList();
+
+	/**
+	 * Keeps at most the given number of keys, no more than the capacity,
+	 * dropping the oldest ones.
+	 */
+  void resize(const std::uint32_t newLimit);
+
+  std::uint32_t size() const { return order.size(); }
+
+	/**
+	 * Returns the slot holding key, or NONE.
+	 */
+  std::uint32_t find(const PageKey key) const;
+
+	/**
+	 * Adds key as the newest entry, dropping the oldest one if the list is full.
+	 *
+	 * @return Slot of the key, NONE if the limit is zero
+	 */
+  std::uint32_t push(const PageKey key);
+
+	/**
+	 * Removes the key in the given slot.
+	 */
+  void erase(const std::uint32_t slot);
+
+	/**
+	 * Removes the oldest key, if there is one.
+	 */
+  void popOldest();
+};
+
+
+/**
+* @brief CLOCK with one reference bit per frame
+*
+* The hand and the reference bits are atomic, so the policy takes no latch
+* and hits cost a single store.
+*/
+class ClockReplacer : public Replacer
+{
+ private:
+  std::atomic<std::uint32_t> numFrames;
+  std::atomic<bool> *refbit;
+  std::atomic<FrameId> clockHand;
+
+	/**
+	 * Advance clock to next frame in the buffer pool
+	 *
+	 * @return The frame the clock hand moved to
+	 */
+  FrameId advanceClock();
+
+ public:
+  ClockReplacer(const std::uint32_t frames, const std::uint32_t capacity);
+  ~ClockReplacer();
+
+  void access(const FrameId frame, const PageKey key);
+  void load(const FrameId frame, const PageKey key);
+  void evict(const FrameId frame);
+  void remove(const FrameId frame);
+  bool victim(FrameId &frame, const std::function<bool(FrameId)> &claim);
+  std::uint32_t upcoming(FrameId *frames, const std::uint32_t max);
+  void resize(const std::uint32_t frames);
+};
+
+
+/**
+* @brief LRU-K (O'Neil, O'Neil and Weikum) with K = 2
+*
+* Evicts the page whose second most recent reference is oldest; pages
+* referenced only once go first, oldest reference first.  The reference
+* times of evicted pages are retained for as many pages as the pool holds,
+* so a page which comes back soon is not treated as new.  Every request is
+* counted as a reference; there is no correlated reference period.
+*/
+class LruKReplacer : public Replacer
+{
+ private:
+  static const int K = 2;
+
+  std::uint32_t numFrames;
+  std::mutex latch;
+
+	/**
+	 * Logical time, incremented on every reference
+	 */
+  std::uint64_t now;
+
+	/**
+	 * Page key of every frame, 0 if the policy does not know the frame
+	 */
+  PageKey *keys;
+
+	/**
+	 * Last K reference times of every frame, most recent first, 0 if unknown
+	 */
+  std::uint64_t *history;
+
+	/**
+	 * Retained reference times of evicted pages, K per ghost slot
+	 */
+  GhostList ghosts;
+  std::uint64_t *ghostHistory;
+
+	/**
+	 * Known frames ordered by (K-th reference, last reference), victim first
+	 */
+  std::set<std::tuple<std::uint64_t, std::uint64_t, FrameId> > order;
+
+  std::tuple<std::uint64_t, std::uint64_t, FrameId> orderKey(const FrameId frame) const;
+  void reference(const FrameId frame);
+
+ public:
+  LruKReplacer(const std::uint32_t frames, const std::uint32_t capacity);
+  ~LruKReplacer();
+
+  void access(const FrameId frame, const PageKey key);
+  void load(const FrameId frame, const PageKey key);
+  void evict(const FrameId frame);
+  void remove(const FrameId frame);
+  bool victim(FrameId &frame, const std::function<bool(FrameId)> &claim);
+  std::uint32_t upcoming(FrameId *frames, const std::uint32_t max);
+  void resize(const std::uint32_t frames);
+};
+
+
+/**
+* @brief Full 2Q (Johnson and Shasha)
+*
+* New pages enter the FIFO A1in.  Pages evicted from A1in are remembered in
+* A1out; if they are requested again while remembered they go to the LRU
+* queue Am.  Victims come from A1in while it holds more than a quarter of the
+* pool and from Am otherwise.  A1out remembers half as many pages as the pool
+* holds.
+*/
+class TwoQReplacer : public Replacer
+{
+ private:
+	/**
+	 * Queue each frame is on
+	 */
+  enum Queue { NO_QUEUE, A1IN, AM };
+
+  std::uint32_t numFrames;
+  std::uint32_t maxA1in;
+  std::mutex latch;
+  PageKey *keys;
+  unsigned char *queue;
+  IndexList a1in;
+  IndexList am;
+  GhostList a1out;
+
+  void unlink(const FrameId frame);
+
+ public:
+  TwoQReplacer(const std::uint32_t frames, const std::uint32_t capacity);
+  ~TwoQReplacer();
+
+  void access(const FrameId frame, const PageKey key);
+  void load(const FrameId frame, const PageKey key);
+  void evict(const FrameId frame);
+  void remove(const FrameId frame);
+  bool victim(FrameId &frame, const std::function<bool(FrameId)> &claim);
+  std::uint32_t upcoming(FrameId *frames, const std::uint32_t max);
+  void resize(const std::uint32_t frames);
+};
+
+
+/**
+* @brief Adaptive Replacement Cache (Megiddo and Modha)
+*
+* Resident pages seen once are on T1 and pages seen more often on T2; the
+* ghost lists B1 and B2 remember pages evicted from them.  A miss on B1 grows
+* the target size p of T1, a miss on B2 shrinks it, and victims come from T1
+* while it is larger than p.  Since BufMgr picks the victim before it loads
+* the missing page, p is adapted when the page is loaded rather than before
+* the victim is chosen.
+*/
+class ArcReplacer : public Replacer
+{
+ private:
+  enum Queue { NO_QUEUE, T1, T2 };
+
+  std::uint32_t numFrames;
+  std::uint32_t p;
+  std::mutex latch;
+  PageKey *keys;
+  unsigned char *queue;
+  IndexList t1;
+  IndexList t2;
+  GhostList b1;
+  GhostList b2;
+
+  void unlink(const FrameId frame);
+
+ public:
+  ArcReplacer(const std::uint32_t frames, const std::uint32_t capacity);
+  ~ArcReplacer();
+
+  void access(const FrameId frame, const PageKey key);
+  void load(const FrameId frame, const PageKey key);
+  void evict(const FrameId frame);
+  void remove(const FrameId frame);
+  bool victim(FrameId &frame, const std::function<bool(FrameId)> &claim);
+  std::uint32_t upcoming(FrameId *frames, const std::uint32_t max);
+  void resize(const std::uint32_t frames);
+};
+
+
+/**
+* @brief CLOCK-Pro (Jiang, Chen and Zhang)
+*
+* Resident pages are hot or cold; cold pages start a test period when they
+* are loaded or referenced.  All pages, and cold pages evicted during their
+* test period, sit on one circular list swept by three hands:
+*
+* - the cold hand evicts unreferenced cold pages, promotes referenced cold
+*   pages in their test period to hot and gives other referenced cold pages
+*   a new test period,
+* - the hot hand demotes unreferenced hot pages to cold and ends the test
+*   periods it passes,
+* - the test hand ends test periods when too many non-resident pages are
+*   remembered.
+*
+* The number of resident cold pages adapts: it grows whenever a page in its
+* test period is requested again and shrinks whenever a test period ends
+* without one.
+*/
+class ClockProReplacer : public Replacer
+{
+ private:
+  static const std::uint32_t NONE = ~0u;
+
+	/**
+	 * Flags of a node
+	 */
+  static const unsigned char HOT = 1;
+  static const unsigned char TEST = 2;
+  static const unsigned char REF = 4;
+
+  std::uint32_t numFrames;
+  std::mutex latch;
+
+	/**
+	 * Nodes of the clock, one per resident page and one per remembered
+	 * non-resident page, hence 2 * numFrames of them
+	 */
+  std::uint32_t numNodes;
+  PageKey *nodeKey;
+  FrameId *nodeFrame;
+  unsigned char *flags;
+  std::uint32_t *prev;
+  std::uint32_t *next;
+  std::uint32_t *freeNodes;
+  std::uint32_t numFree;
+
+	/**
+	 * Node of every frame, NONE if the policy does not know the frame
+	 */
+  std::uint32_t *frameNode;
+
+	/**
+	 * Node of every page on the clock
+	 */
+  BufHashTbl index;
+
+  std::uint32_t handHot;
+  std::uint32_t handCold;
+  std::uint32_t handTest;
+
+  std::uint32_t numHot;
+  std::uint32_t numCold;
+  std::uint32_t numTest;
+
+	/**
+	 * Target number of resident cold pages
+	 */
+  std::uint32_t coldTarget;
+
+  void link(const std::uint32_t node);
+  void unlink(const std::uint32_t node);
+  void drop(const std::uint32_t node);
+  void endTest(const std::uint32_t node);
+  bool runHandHot();
+  bool runHandTest();
+
+ public:
+  ClockProReplacer(const std::uint32_t frames, const std::uint32_t capacity);
+  ~ClockProReplacer();
+
+  void access(const FrameId frame, const PageKey key);
+  void load(const FrameId frame, const PageKey key);
+  void evict(const FrameId frame);
+  void remove(const FrameId frame);
+  bool victim(FrameId &frame, const std::function<bool(FrameId)> &claim);
+  std::uint32_t upcoming(FrameId *frames, const std::uint32_t max);
+  void resize(const std::uint32_t frames);
+};
+
+}
@@ -0,0 +1,178 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include "reuseTracker.h"
+
+namespace badgerdb
+{
+
+ReuseTracker::ReuseTracker()
+	: active(false), threshold(0), rate(1.0), bucketFrames(1), histogram(BUCKETS + 1, 0),
+	  coldAccesses(0), startReads(0), stopReads(0), now(0)
+{
+}
+
+/**
+* Starts tracking accesses afresh.
+*
+* @param sampleRate   Fraction of the pages to track, in (0, 1]
+* @param maxFrames    Largest pool size the curve is estimated for
+* @param reads        Reads counted by the caller so far
+*/
+void ReuseTracker::start(const double sampleRate, const std::uint32_t maxFrames, const std::uint64_t reads)
+{
+	std::lock_guard<std::mutex> guard(latch);
+	const double clamped = std::min(std::max(sampleRate, 1.0 / MODULUS), 1.0);
+	const std::uint64_t limit = (std::uint64_t)std::llround(clamped * MODULUS);
+	rate = (double)limit / MODULUS;
+	bucketFrames = std::max<std::uint32_t>(1, (maxFrames + BUCKETS - 1) / BUCKETS);
+	histogram.assign(BUCKETS + 1, 0);
+	coldAccesses = 0;
+	startReads = reads;
+	stopReads = 0;
+	lastAccess.clear();
+	tree.assign(1 << 16, 0);
+	now = 0;
+	threshold.store(limit, std::memory_order_relaxed);
+	active.store(true, std::memory_order_release);
+}
+
+/**
+* Stops tracking accesses and frees the tracking state.
+*
+* @param reads   Reads counted by the caller so far
+*/
+void ReuseTracker::stop(const std::uint64_t reads)
+{
+	std::lock_guard<std::mutex> guard(latch);
+	if (active.load(std::memory_order_relaxed))
+		stopReads = std::max<std::uint64_t>(reads, 1);
+	active.store(false, std::memory_order_relaxed);
+	threshold.store(0, std::memory_order_relaxed);
+	std::unordered_map<PageKey, std::uint32_t>().swap(lastAccess);
+	std::vector<std::uint32_t>().swap(tree);
+	now = 0;
+}
+
+void ReuseTracker::add(std::uint32_t time, const int delta)
+{
+	for (time++; time <= tree.size(); time += time & -time)
+		tree[time - 1] += delta;
+}
+
+std::uint32_t ReuseTracker::prefix(std::uint32_t time) const
+{
+	std::uint32_t sum = 0;
+	for (time++; time > 0; time -= time & -time)
+		sum += tree[time - 1];
+	return sum;
+}
+
+void ReuseTracker::compact()
+{
+	std::vector<std::pair<std::uint32_t, PageKey>> order;
+	order.reserve(lastAccess.size());
+	for (const auto &entry : lastAccess)
+		order.push_back(std::make_pair(entry.second, entry.first));
+	std::sort(order.begin(), order.end());
+
+	std::size_t size = tree.size();
+	while (order.size() > size / 2)
+		size *= 2;
+	for (std::uint32_t time = 0; time < order.size(); time++)
+		lastAccess[order[time].second] = time;
+
+	// builds the tree of a one at every time below order.size() in linear time
+	tree.assign(size, 0);
+	for (std::uint32_t time = 0; time < size; time++)
+	{
+		if (time < order.size())
+			tree[time] += 1;
+		const std::uint32_t parent = time + ((time + 1) & -(time + 1));
+		if (parent < size)
+			tree[parent] += tree[time];
+	}
+	now = order.size();
+}
+
+/**
+* Tracks an access to a sampled page: counts its reuse distance in the
+* histogram and moves its last access to now.
+*/
+void ReuseTracker::recordSampled(const PageKey key)
+{
+	std::lock_guard<std::mutex> guard(latch);
+	// start() or stop() may have run since the caller read the threshold
+	if (!active.load(std::memory_order_relaxed)
+			|| (hash(key) & (MODULUS - 1)) >= threshold.load(std::memory_order_relaxed))
+		return;
+
+	auto it = lastAccess.find(key);
+	if (it == lastAccess.end())
+	{
+		coldAccesses++;
+		it = lastAccess.emplace(key, now).first;
+	}
+	else
+	{
+		// distinct sampled pages accessed after the previous access
+		const std::uint32_t distance = prefix(now - 1) - prefix(it->second);
+		const double frames = distance / rate;
+		const double bucket = frames / bucketFrames;
+		histogram[bucket < BUCKETS ? (std::uint32_t)bucket : BUCKETS]++;
+		add(it->second, -1);
+		it->second = now;
+	}
+	add(now, 1);
+	if (++now == tree.size())
+		compact();
+}
+
+/**
+* Returns the estimated miss ratio curve.  A pool of frames frames hits an
+* access if fewer than frames distinct pages were used since the previous
+* access to the page, as it would under LRU.
+*
+* @param reads   Reads counted by the caller so far
+*/
+std::vector<MissRatioPoint> ReuseTracker::curve(const std::uint64_t reads) const
+{
+	std::lock_guard<std::mutex> guard(latch);
+	std::uint64_t sampled = coldAccesses;
+	for (const std::uint64_t count : histogram)
+		sampled += count;
+
+	// a few hot pages in or out of the sample skew it the most; the sampled
+	// accesses missing from or exceeding their expected number are taken to be
+	// hits in any pool, which counters most of the skew (SHARDS-adj); left
+	// out if the caller's counter was reset meanwhile
+	const std::uint64_t last = stopReads > 0 ? stopReads : reads;
+	double total = sampled;
+	double hits = 0;
+	if (last > startReads)
+	{
+		total = (last - startReads) * rate;
+		hits = total - sampled;
+	}
+
+	std::vector<MissRatioPoint> points;
+	points.reserve(BUCKETS);
+	for (std::uint32_t bucket = 0; bucket < BUCKETS; bucket++)
+	{
+		hits += histogram[bucket];
+		MissRatioPoint point;
+		point.frames = (bucket + 1) * bucketFrames;
+		point.missRatio = total > 0 ? std::min(std::max(1.0 - hits / total, 0.0), 1.0) : 0.0;
+		points.push_back(point);
+	}
+	return points;
+}
+
+}
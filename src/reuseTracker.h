@@ -0,0 +1,204 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+* @brief One point of a miss ratio curve
+*/
+struct MissRatioPoint
+{
+	/**
+   * Number of frames of the buffer pool
+	 */
+  std::uint32_t frames;
+
+	/**
+   * Estimated fraction of accesses which would miss in a pool of that size
+	 */
+  double missRatio;
+};
+
+/**
+* @brief Estimates the miss ratio curve of a page reference stream by spatial
+* sampling of reuse distances (SHARDS)
+*
+* A page is sampled if the hash of its key falls below a threshold, so a
+* sampled page has all of its accesses tracked and a fraction rate of all
+* pages is tracked.  For every access to a sampled page the tracker counts
+* the distinct sampled pages used since its previous access; divided by rate
+* this estimates the page's LRU stack distance, which a pool of more frames
+* than that would have hit.  Distances are counted in a histogram, from which
+* curve() derives the miss ratio at every pool size.  Given the number of all
+* reads, curve() also corrects the skew of a sample which holds more or fewer
+* hot pages than its share (SHARDS-adj).
+*
+* Accesses to pages which are not sampled cost one hash and one comparison.
+* Sampled accesses take a latch and update a Fenwick tree over the time of
+* every tracked page's last access, in O(log n) for n tracked pages.  Memory
+* grows with the number of distinct sampled pages, about rate times the
+* number of distinct pages used.
+*/
+class ReuseTracker
+{
+ private:
+	/**
+   * Sampling thresholds are fractions of this modulus
+	 */
+  static constexpr std::uint64_t MODULUS = 1 << 24;
+
+	/**
+   * Number of buckets of the distance histogram
+	 */
+  static constexpr std::uint32_t BUCKETS = 256;
+
+	/**
+   * True while accesses are tracked
+	 */
+  std::atomic<bool> active;
+
+	/**
+   * Pages whose hash modulo MODULUS is below threshold are sampled
+	 */
+  std::atomic<std::uint64_t> threshold;
+
+	/**
+   * Sampling rate, threshold / MODULUS
+	 */
+  double rate;
+
+	/**
+   * Width of a histogram bucket, in frames
+	 */
+  std::uint32_t bucketFrames;
+
+	/**
+   * Accesses to sampled pages by estimated stack distance, in buckets of
+   * bucketFrames frames; the last bucket holds all larger distances
+	 */
+  std::vector<std::uint64_t> histogram;
+
+	/**
+   * First accesses to sampled pages, which miss in a pool of any size
+	 */
+  std::uint64_t coldAccesses;
+
+	/**
+   * Reads of all pages, sampled or not, counted by the caller when tracking
+   * started and stopped; stopReads is zero while tracking
+	 */
+  std::uint64_t startReads;
+  std::uint64_t stopReads;
+
+	/**
+   * Time of the last access to each tracked page
+	 */
+  std::unordered_map<PageKey, std::uint32_t> lastAccess;
+
+	/**
+   * Fenwick tree with a one at the time of the last access of every tracked
+   * page, and the next time; times are renumbered when the tree is full
+	 */
+  std::vector<std::uint32_t> tree;
+  std::uint32_t now;
+
+	/**
+   * Protects everything but active and threshold
+	 */
+  mutable std::mutex latch;
+
+	/**
+   * Adds delta at time in the Fenwick tree
+	 */
+  void add(std::uint32_t time, const int delta);
+
+	/**
+   * Returns the number of ones at times up to and including time
+	 */
+  std::uint32_t prefix(std::uint32_t time) const;
+
+	/**
+   * Renumbers the last accesses 0, 1, ..., keeping their order, and grows
+   * the tree if more than half of it is in use
+	 */
+  void compact();
+
+	/**
+   * Hash of a page key, uniform over 64 bits
+	 */
+  static std::uint64_t hash(const PageKey key)
+  {
+		std::uint64_t h = key + 0x9E3779B97F4A7C15ULL;
+		h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+		return h ^ (h >> 31);
+  }
+
+	/**
+   * Tracks an access to a sampled page
+	 */
+  void recordSampled(const PageKey key);
+
+ public:
+  ReuseTracker();
+
+  ReuseTracker(const ReuseTracker &) = delete;
+  ReuseTracker &operator=(const ReuseTracker &) = delete;
+
+	/**
+	 * Starts tracking accesses afresh.
+	 *
+	 * @param sampleRate   	Fraction of the pages to track, in (0, 1]
+	 * @param maxFrames   	Largest pool size the curve is estimated for
+	 * @param reads   		Reads counted by the caller so far
+	 */
+  void start(const double sampleRate, const std::uint32_t maxFrames, const std::uint64_t reads);
+
+	/**
+	 * Stops tracking accesses and frees the tracking state; the histogram,
+	 * and so the curve, are kept until the next start().
+	 *
+	 * @param reads   		Reads counted by the caller so far
+	 */
+  void stop(const std::uint64_t reads);
+
+	/**
+	 * Returns true while accesses are tracked.
+	 */
+  bool enabled() const { return active.load(std::memory_order_relaxed); }
+
+	/**
+	 * Tracks an access to the page, if the page is sampled.
+	 *
+	 * @param key   	Page key
+	 */
+  void record(const PageKey key)
+  {
+		if ((hash(key) & (MODULUS - 1)) < threshold.load(std::memory_order_relaxed))
+			recordSampled(key);
+  }
+
+	/**
+	 * Returns the estimated miss ratio curve: the miss ratio at a pool size
+	 * of every multiple of the bucket width, up to maxFrames.
+	 *
+	 * @param reads   		Reads counted by the caller so far
+	 */
+  std::vector<MissRatioPoint> curve(const std::uint64_t reads) const;
+};
+
+}
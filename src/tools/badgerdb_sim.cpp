@@ -0,0 +1,249 @@
+/**
+ * Replays a page access trace against the replacement policies.
+ *
+ * Reads a trace written by BufMgr::startTrace() once and feeds every event
+ * to a simulated buffer pool for each combination of pool size and policy.
+ * The simulated pools keep the pins, dirty bits and free list of BufMgr and
+ * use the same Replacer objects, but do no I/O.  Prints the hit ratio of the
+ * reads, the misses, the pages written back by evictions and by a final
+ * flush, and the accesses which found every frame pinned.
+ *
+ * Usage: ./tools/badgerdb_sim trace frames[,frames...] [policy[,policy...]]
+ *
+ * Policies are named as in Replacer::name(): CLOCK, LRU-2, 2Q, ARC, CLOCK-Pro;
+ * all of them by default.
+ */
+
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#include "pageTrace.h"
+#include "replacer.h"
+
+using namespace badgerdb;
+
+namespace {
+
+const ReplacementPolicy POLICIES[] = {
+	ReplacementPolicy::CLOCK, ReplacementPolicy::LRU_K, ReplacementPolicy::TWO_Q,
+	ReplacementPolicy::ARC, ReplacementPolicy::CLOCK_PRO
+};
+
+/**
+ * Buffer pool of the given size and policy which only keeps track of which
+ * page every frame holds.
+ */
+class Simulation
+{
+ public:
+	const ReplacementPolicy policy;
+	const std::uint32_t numFrames;
+	std::uint64_t hits = 0;
+	std::uint64_t misses = 0;
+	std::uint64_t allocs = 0;
+	std::uint64_t writebacks = 0;
+	std::uint64_t exceeded = 0;
+
+	Simulation(const ReplacementPolicy policy, const std::uint32_t numFrames)
+		: policy(policy), numFrames(numFrames), replacer(Replacer::create(policy, numFrames)),
+		  keys(numFrames), pins(numFrames, 0), dirty(numFrames, false)
+	{
+		for (FrameId frame = numFrames; frame > 0; frame--)
+			freeFrames.push_back(frame - 1);
+	}
+
+	~Simulation()
+	{
+		delete replacer;
+	}
+
+	void replay(const TraceRecord &record)
+	{
+		const PageKey key = makePageKey(record.file, record.pageNo);
+		auto it = frames.find(key);
+		switch (record.op)
+		{
+			case TraceOp::READ:
+			case TraceOp::ALLOC:
+				if (it != frames.end())
+				{
+					if (record.op == TraceOp::READ)
+						hits++;
+					pins[it->second]++;
+					replacer->access(it->second, key);
+					return;
+				}
+				FrameId frame;
+				if (!allocFrame(frame))
+				{
+					exceeded++;
+					return;
+				}
+				if (record.op == TraceOp::READ)
+					misses++;
+				else
+					allocs++;
+				frames[key] = frame;
+				keys[frame] = key;
+				pins[frame] = 1;
+				replacer->load(frame, key);
+				return;
+			case TraceOp::UNPIN:
+			case TraceOp::DIRTY:
+				if (it == frames.end() || pins[it->second] == 0)
+					return;
+				pins[it->second]--;
+				if (record.op == TraceOp::DIRTY)
+					dirty[it->second] = true;
+				return;
+			case TraceOp::DISPOSE:
+				if (it == frames.end())
+					return;
+				replacer->remove(it->second);
+				pins[it->second] = 0;
+				dirty[it->second] = false;
+				freeFrames.push_back(it->second);
+				frames.erase(it);
+				return;
+		}
+	}
+
+	/**
+	 * Number of dirty pages a flush at the end of the trace writes back
+	 */
+	std::uint64_t dirtyPages() const
+	{
+		std::uint64_t count = 0;
+		for (const auto &entry : frames)
+			count += dirty[entry.second];
+		return count;
+	}
+
+ private:
+	Replacer *replacer;
+	std::unordered_map<PageKey, FrameId> frames;
+	std::vector<PageKey> keys;
+	std::vector<std::uint32_t> pins;
+	std::vector<bool> dirty;
+	std::vector<FrameId> freeFrames;
+
+	bool allocFrame(FrameId &frame)
+	{
+		if (!freeFrames.empty())
+		{
+			frame = freeFrames.back();
+			freeFrames.pop_back();
+			return true;
+		}
+		if (!replacer->victim(frame, [this](const FrameId candidate) { return pins[candidate] == 0; }))
+			return false;
+		if (dirty[frame])
+			writebacks++;
+		dirty[frame] = false;
+		frames.erase(keys[frame]);
+		replacer->evict(frame);
+		return true;
+	}
+};
+
+std::vector<std::string> split(const std::string &list)
+{
+	std::vector<std::string> items;
+	std::stringstream stream(list);
+	std::string item;
+	while (std::getline(stream, item, ','))
+		items.push_back(item);
+	return items;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 3)
+	{
+		std::cerr << "usage: " << argv[0] << " trace frames[,frames...] [policy[,policy...]]\n";
+		return 2;
+	}
+
+	std::vector<ReplacementPolicy> policies;
+	if (argc > 3)
+	{
+		for (const std::string &name : split(argv[3]))
+		{
+			bool known = false;
+			for (const ReplacementPolicy policy : POLICIES)
+			{
+				if (name == Replacer::name(policy))
+				{
+					policies.push_back(policy);
+					known = true;
+				}
+			}
+			if (!known)
+			{
+				std::cerr << "unknown policy " << name << "\n";
+				return 2;
+			}
+		}
+	}
+	else
+		policies.assign(std::begin(POLICIES), std::end(POLICIES));
+
+	std::vector<Simulation*> simulations;
+	for (const std::string &size : split(argv[2]))
+	{
+		const long frames = std::atol(size.c_str());
+		if (frames <= 0)
+		{
+			std::cerr << "bad pool size " << size << "\n";
+			return 2;
+		}
+		for (const ReplacementPolicy policy : policies)
+			simulations.push_back(new Simulation(policy, frames));
+	}
+
+	std::uint64_t events = 0;
+	try
+	{
+		TraceReader reader(argv[1]);
+		TraceRecord record;
+		while (reader.next(record))
+		{
+			events++;
+			for (Simulation *simulation : simulations)
+				simulation->replay(record);
+		}
+	}
+	catch (const std::system_error &e)
+	{
+		std::cerr << e.what() << "\n";
+		return 1;
+	}
+
+	std::cout << events << " events\n";
+	std::cout << std::left << std::setw(11) << "policy" << std::right << std::setw(10) << "frames"
+	          << std::setw(10) << "hit ratio" << std::setw(12) << "misses" << std::setw(12) << "writebacks"
+	          << std::setw(12) << "flushed" << std::setw(10) << "exceeded" << "\n";
+	for (Simulation *simulation : simulations)
+	{
+		const std::uint64_t accesses = simulation->hits + simulation->misses;
+		std::cout << std::left << std::setw(11) << Replacer::name(simulation->policy) << std::right
+		          << std::setw(10) << simulation->numFrames
+		          << std::setw(10) << std::fixed << std::setprecision(4)
+		          << (accesses > 0 ? (double)simulation->hits / accesses : 0.0)
+		          << std::setw(12) << simulation->misses
+		          << std::setw(12) << simulation->writebacks
+		          << std::setw(12) << simulation->dirtyPages()
+		          << std::setw(10) << simulation->exceeded << "\n";
+		delete simulation;
+	}
+	return 0;
+}
@@ -0,0 +1,137 @@
+/**
+ * Prints the buffer pool statistics of a running process.
+ *
+ * Attaches to the shared memory object which BufMgr::exportStats() keeps up
+ * to date and prints the counters of the whole pool and of each file, once
+ * or, given an interval, every interval seconds until interrupted.
+ *
+ * Usage: ./tools/badgerdb_stat name [interval]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "bufStats.h"
+
+using namespace badgerdb;
+
+namespace {
+
+/**
+ * Copies the region as the exporting process last wrote it.  Fails if the
+ * region was being updated meanwhile.
+ */
+bool snapshot(const BufStatsRegion *region, BufStatsRegion &copy)
+{
+	const std::uint64_t before = region->sequence.load(std::memory_order_acquire);
+	if (before & 1)
+		return false;
+	copy.pid = region->pid;
+	copy.frames = region->frames;
+	copy.updatedMs = region->updatedMs;
+	copy.totals.copyFrom(region->totals);
+	copy.numFiles = std::min<std::uint32_t>(region->numFiles, BufStats::FILE_SLOTS + 1);
+	for (std::uint32_t i = 0; i < copy.numFiles; i++)
+	{
+		copy.files[i].file = region->files[i].file;
+		std::memcpy(copy.files[i].name, region->files[i].name, BufStatsRegion::NAME_LEN);
+		copy.files[i].name[BufStatsRegion::NAME_LEN - 1] = '\0';
+		copy.files[i].counters.copyFrom(region->files[i].counters);
+	}
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return region->sequence.load(std::memory_order_relaxed) == before;
+}
+
+void printRow(const std::string &name, const BufCounters &counters)
+{
+	std::cout << std::left << std::setw(20) << name.substr(0, 19) << std::right
+	          << std::setw(12) << counters.accesses
+	          << std::setw(8) << std::fixed << std::setprecision(1) << 100.0 * counters.hitRatio()
+	          << std::setw(10) << counters.misses
+	          << std::setw(10) << counters.allocations
+	          << std::setw(10) << counters.prefetchreads
+	          << std::setw(10) << counters.diskwrites
+	          << std::setw(10) << counters.cleanevictions
+	          << std::setw(10) << counters.dirtyevictions
+	          << std::setw(9) << counters.disposes
+	          << std::setw(8) << counters.flushes << "\n";
+}
+
+void print(const BufStatsRegion &region)
+{
+	const std::uint64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+	    std::chrono::system_clock::now().time_since_epoch()).count();
+	std::cout << "pid " << region.pid << "  frames " << region.frames
+	          << "  updated " << (now > region.updatedMs ? now - region.updatedMs : 0) << " ms ago"
+	          << "  sweeps " << region.totals.sweeps
+	          << "  steps/sweep " << std::fixed << std::setprecision(2) << region.totals.stepsPerSweep()
+	          << "  bgwrites " << region.totals.bgwrites << "\n";
+	std::cout << std::left << std::setw(20) << "file" << std::right
+	          << std::setw(12) << "accesses" << std::setw(8) << "hit%"
+	          << std::setw(10) << "misses" << std::setw(10) << "allocs"
+	          << std::setw(10) << "prefetch" << std::setw(10) << "writes"
+	          << std::setw(10) << "clean-ev" << std::setw(10) << "dirty-ev"
+	          << std::setw(9) << "disposes" << std::setw(8) << "flushes" << "\n";
+	for (std::uint32_t i = 0; i < region.numFiles; i++)
+	{
+		const BufStatsRegion::FileEntry &entry = region.files[i];
+		printRow(entry.name[0] ? entry.name : "file " + std::to_string(entry.file), entry.counters);
+	}
+	printRow("total", region.totals);
+	std::cout << std::endl;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2)
+	{
+		std::cerr << "usage: " << argv[0] << " name [interval]\n";
+		return 2;
+	}
+	const int interval = argc > 2 ? std::atoi(argv[2]) : 0;
+
+	const int fd = shm_open(argv[1], O_RDONLY, 0);
+	if (fd < 0)
+	{
+		std::cerr << argv[1] << ": " << std::strerror(errno) << "\n";
+		return 1;
+	}
+	void *mem = mmap(NULL, sizeof(BufStatsRegion), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (mem == MAP_FAILED)
+	{
+		std::cerr << argv[1] << ": " << std::strerror(errno) << "\n";
+		return 1;
+	}
+	const BufStatsRegion *region = static_cast<const BufStatsRegion *>(mem);
+	if (region->magic != BufStatsRegion::MAGIC)
+	{
+		std::cerr << argv[1] << ": not a buffer pool statistics region\n";
+		return 1;
+	}
+
+	BufStatsRegion *copy = new BufStatsRegion();
+	do
+	{
+		while (!snapshot(region, *copy))
+			std::this_thread::yield();
+		print(*copy);
+		if (interval > 0)
+			std::this_thread::sleep_for(std::chrono::seconds(interval));
+	} while (interval > 0);
+	delete copy;
+	munmap(mem, sizeof(BufStatsRegion));
+	return 0;
+}
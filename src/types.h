@@ -7,6 +7,8 @@
 
 #pragma once
 
+#include <cstdint>
+
 namespace badgerdb {
 
 /**
@@ -24,6 +26,48 @@ typedef std::uint16_t SlotId;
  */
 typedef std::uint32_t FrameId;
 
+/**
+ * @brief Dense identifier for an open underlying file, assigned by File.
+ */
+typedef std::uint32_t FileId;
+
+/**
+ * @brief Identifier for a page across all files: (FileId, PageId) packed into
+ *        64 bits, file in the high half and page in the low half.
+ */
+typedef std::uint64_t PageKey;
+
+/**
+ * Packs a file identifier and a page number into a page key.
+ *
+ * @param file_id     Identifier of the file.
+ * @param page_number Number of the page within the file.
+ * @return  The page key.
+ */
+inline PageKey makePageKey(const FileId file_id, const PageId page_number) {
+  return (static_cast<PageKey>(file_id) << 32) | page_number;
+}
+
+/**
+ * Returns the file identifier packed into a page key.
+ *
+ * @param key   Page key.
+ * @return  Identifier of the file.
+ */
+inline FileId pageKeyFile(const PageKey key) {
+  return static_cast<FileId>(key >> 32);
+}
+
+/**
+ * Returns the page number packed into a page key.
+ *
+ * @param key   Page key.
+ * @return  Number of the page within its file.
+ */
+inline PageId pageKeyPage(const PageKey key) {
+  return static_cast<PageId>(key);
+}
+
 /**
  * @brief Identifier for a record in a page.
  */